@@ -3,23 +3,43 @@
 
 #include <SDL2/SDL.h>
 
+#include <cstddef>
 #include <cstdint>
 
 class Bitmap
 {
 private:
     SDL_Renderer* renderer_;
+
+    // Column-major copy of the frame that column spans render into, transposed into pixels_ afterwards.
+    std::uint32_t* columns_;
+    bool column_major_;
+
+    // Top-left part of the bitmap the 3D view renders into; Render() stretches it over the whole window.
+    int view_width_;
+    int view_height_;
+
+    // Frames are drawn straight into the locked streaming texture; renderers that cannot lock it get 
+    // frames drawn into this buffer and uploaded by Render() instead.
+    std::uint32_t* buffer_;
+    bool locked_;
+    bool lock_supported_;
+    bool frame_drawn_;
     
 public:
     std::size_t width_;
     std::size_t height_;
+    // Frame being drawn, the locked texture memory or buffer_; row y starts at pixels_ + y * pitch_.
     std::uint32_t* pixels_;
+    std::size_t pitch_;
 	SDL_Texture* texture_;
 
+    // Without a renderer, the bitmap is an off-screen layer for DrawBitmap() and has no texture.
     Bitmap(SDL_Renderer* renderer, std::size_t width, std::size_t height);
 
     ~Bitmap();
 
+    // Copies the view of bitmap.
     void DrawBitmap(const Bitmap& bitmap, int x_offset, int y_offset);
 
     void DrawFillRect(int top_left_x, int top_left_y, int bottom_right_x, int bottom_right_y, std::uint32_t color);
@@ -28,9 +48,33 @@ public:
 
     void DrawPoint(int x, int y, std::uint32_t color);
 
+    // Cuts the line down to the part inside the view; false if none of it is.
+    bool ClipLine(int& x1, int& y1, int& x2, int& y2);
+
+    // Makes pixels_ the target of the next frame. Locked texture memory holds undefined contents, so the 
+    // whole view must be drawn before the next Render().
+    void BeginFrame();
+
     void Render();
 
     void Clear();
+
+    std::uint32_t GetClearColor();
+
+    void SetColumnMajor(bool column_major);
+
+    bool IsColumnMajor();
+
+    // Pointer to the top pixel of column x in the active render target; pixel y is at column[y * stride].
+    std::uint32_t* GetColumn(int x, std::ptrdiff_t& stride);
+
+    void TransposeColumns(int begin_x, int end_x);
+
+    void SetViewport(int view_width, int view_height);
+
+    int GetViewWidth();
+
+    int GetViewHeight();
 };
 
 #endif
\ No newline at end of file
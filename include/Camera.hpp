@@ -0,0 +1,52 @@
+#ifndef CAMERA_HPP
+#define CAMERA_HPP
+
+#include "Vect2d.hpp"
+
+#include <vector>
+
+// Per-column ray tables for the ray pass. The screen coordinate of every column only changes with 
+// the view width, and the rays only when the camera turns or the FOV changes, so both are rebuilt 
+// then rather than per ray.
+class Camera
+{
+private:
+	// Position of every column on the camera plane, from -1 at the left edge towards +1 at the right.
+	std::vector<double> camera_x_;
+	std::vector<Vect2d<double>> ray_dirs_;
+	std::vector<double> ray_lengths_;
+
+	int view_width_;
+	Vect2d<float> direction_;
+	Vect2d<float> plane_;
+	double direction_length_;
+
+	// Cosine and sine of the last rotation asked for, which is the same one every tick while turning.
+	int rotation_degrees_;
+	double rotation_cos_;
+	double rotation_sin_;
+
+public:
+	Camera(int max_view_width);
+
+	void Update(int view_width, const Vect2d<float>& direction, const Vect2d<float>& plane);
+
+	void GetRotation(int degrees, double& cos_degrees, double& sin_degrees);
+
+	const Vect2d<double>& GetRayDirection(int x) const
+	{
+		return ray_dirs_[x];
+	}
+
+	double GetRayLength(int x) const
+	{
+		return ray_lengths_[x];
+	}
+
+	double GetDirectionLength() const
+	{
+		return direction_length_;
+	}
+};
+
+#endif
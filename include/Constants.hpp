@@ -1,11 +1,35 @@
 #ifndef CONSTANTS_HPP
 #define CONSTANTS_HPP
 
+#include <cstdint>
+
 namespace constants
 {
 	inline constexpr char game_title[] = "Untextured Raycasting tech demo"; 
 	inline constexpr int screen_width = 1280;
 	inline constexpr int screen_height = 960;
+	inline constexpr int column_band_width = 32;
+	inline constexpr int row_band_height = 16;
+	// Adaptive casting traces every adaptive_ray_spacing-th column and fills in the ones between.
+	inline constexpr int adaptive_ray_spacing = 8;
+	inline constexpr double adaptive_max_distance_change = 0.25;
+
+	// The temporal cache seeds this frame's rays with the last frame's hits while the camera moved at most this far.
+	inline constexpr double temporal_max_translation = 0.25;
+	// Pixels per tile of the minimap, which is drawn over the top-left corner of the view, before zooming.
+	inline constexpr int map_scale_factor = 16;
+	// A minimap wider or taller than the view is windowed to 1 / map_view_divisor of that side, so the scene stays in sight.
+	inline constexpr int map_view_divisor = 4;
+	// Rows the horizon sits below the middle of the screen.
+	inline constexpr int view_pitch = 100;
+	inline constexpr int fog_level_count = 8;
+	inline constexpr double fog_distance = 16.0;
+
+	// Levels held in memory or mapped index their tile grids, padded with a one-tile border, with ints.
+	inline constexpr std::int64_t max_padded_tile_count = INT32_MAX;
+	// Largest side of a generated maze: odd, and a square maze of this side still fits max_padded_tile_count with its border.
+	inline constexpr int max_maze_side = 46337;
+	static_assert((max_maze_side + 2LL) * (max_maze_side + 2) <= max_padded_tile_count, "Maze tile indices must fit into an int.");
 } // namespace constants
 
 #endif
\ No newline at end of file
@@ -0,0 +1,135 @@
+#ifndef FIXED_POINT_HPP
+#define FIXED_POINT_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Fixed-point number with 16 fractional bits, for the integer DDA backend. Everything but the 
+// conversions is integer arithmetic, so traces come out the same with every compiler and CPU. 
+// The 64-bit raw value leaves room for the huge step sizes of nearly axis-aligned rays.
+struct Fixed16
+{
+	static constexpr int fraction_bits = 16;
+	static constexpr std::int64_t one = std::int64_t{ 1 } << fraction_bits;
+	// Step size of a ray parallel to an axis, far beyond any map but clear of overflow in the DDA.
+	static constexpr std::int64_t max_step = std::int64_t{ 1 } << 40;
+
+	std::int64_t raw_;
+
+	static Fixed16 FromDouble(double value)
+	{
+		return { static_cast<std::int64_t>(std::llround(value * one)) };
+	}
+
+	double ToDouble() const
+	{
+		return static_cast<double>(raw_) / one;
+	}
+
+	Fixed16& operator+=(Fixed16 other)
+	{
+		raw_ += other.raw_;
+		return *this;
+	}
+
+	Fixed16& operator-=(Fixed16 other)
+	{
+		raw_ -= other.raw_;
+		return *this;
+	}
+};
+
+inline Fixed16 operator+(Fixed16 a, Fixed16 b)
+{
+	return { a.raw_ + b.raw_ };
+}
+
+inline Fixed16 operator-(Fixed16 a, Fixed16 b)
+{
+	return { a.raw_ - b.raw_ };
+}
+
+inline Fixed16 operator*(Fixed16 a, Fixed16 b)
+{
+	return { (a.raw_ * b.raw_) >> Fixed16::fraction_bits };
+}
+
+inline Fixed16 operator*(int a, Fixed16 b)
+{
+	return { a * b.raw_ };
+}
+
+inline bool operator<(Fixed16 a, Fixed16 b)
+{
+	return a.raw_ < b.raw_;
+}
+
+// Integer version of the template in PacketTracer.hpp, picked by overload resolution for the fixed-point DDA.
+inline int CountSkippedCrossings(Fixed16 ray_length, Fixed16 ray_step_size, Fixed16 skip_length, int max_crossings)
+{
+	if (!(ray_length < skip_length))
+	{
+		return 0;
+	}
+
+	const std::int64_t crossings = (skip_length.raw_ - ray_length.raw_ + ray_step_size.raw_ - 1) / ray_step_size.raw_;
+
+	return static_cast<int>(std::min<std::int64_t>(max_crossings, crossings));
+}
+
+// Conversions for code written once for both DDA backends.
+template <typename T>
+T ToScalar(double value);
+
+template <>
+inline double ToScalar<double>(double value)
+{
+	return value;
+}
+
+template <>
+inline Fixed16 ToScalar<Fixed16>(double value)
+{
+	return Fixed16::FromDouble(value);
+}
+
+inline double ToDouble(double value)
+{
+	return value;
+}
+
+inline double ToDouble(Fixed16 value)
+{
+	return value.ToDouble();
+}
+
+// Distance along a ray between two grid lines of an axis the ray moves by direction per unit.
+template <typename T>
+T GetAxisStepSize(double direction);
+
+template <>
+inline double GetAxisStepSize<double>(double direction)
+{
+	return std::abs(1 / direction);
+}
+
+template <>
+inline Fixed16 GetAxisStepSize<Fixed16>(double direction)
+{
+	// The direction gets 32 fractional bits for the division, since the step of a nearly 
+	// axis-aligned ray depends on its tiny other component.
+	constexpr int direction_bits = 32;
+	const std::int64_t magnitude = std::llabs(std::llround(std::ldexp(direction, direction_bits)));
+
+	if (magnitude == 0)
+	{
+		return { Fixed16::max_step };
+	}
+
+	const std::int64_t numerator = std::int64_t{ 1 } << (direction_bits + Fixed16::fraction_bits);
+
+	return { std::min(numerator / magnitude, Fixed16::max_step) };
+}
+
+#endif
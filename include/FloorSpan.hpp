@@ -0,0 +1,29 @@
+#ifndef FLOOR_SPAN_HPP
+#define FLOOR_SPAN_HPP
+
+#include <cstdint>
+
+// One screen row of floor or ceiling: the texel coordinates seen by pixel x are (u_ + x * du_, v_ + x * dv_), 
+// looked up in a column-major texture of texture_width_ x texture_height_ texels that wraps around.
+struct FloorSpan
+{
+	float u_;
+	float v_;
+	float du_;
+	float dv_;
+	const std::uint32_t* texels_;
+	int texture_width_;
+	int texture_height_;
+};
+
+// Fills the pixels [begin_x, end_x) of screen row y that no wall covers, i.e. where y < wall_tops[x] or y >= wall_bottoms[x].
+using FloorSpanKernel = void (*)(const FloorSpan& span, int y, const int* wall_tops, const int* wall_bottoms, std::uint32_t* row, int begin_x, int end_x);
+
+// Kernel specialised for the texture's size, picked once per row: power-of-two sides wrap with masks, 
+// eight pixels at a time where AVX2 is available, and other sides wrap with remainders.
+FloorSpanKernel GetFloorSpanKernel(bool power_of_two_size);
+
+// Fills the same pixels as DrawFloorSpan with one color and returns how many it filled.
+int ClearFloorSpan(std::uint32_t color, int y, const int* wall_tops, const int* wall_bottoms, std::uint32_t* row, int begin_x, int end_x);
+
+#endif
@@ -2,12 +2,16 @@
 #define GAME_HPP
 
 #include "Level.hpp"
+#include "Options.hpp"
 #include "Player.hpp"
+#include "ResolutionController.hpp"
 #include "Screen.hpp"
 #include "Texture.hpp"
+#include "ThreadPool.hpp"
 
 #include <SDL2/SDL.h>
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -20,30 +24,61 @@ class Game
 
 private:
 	bool initialized_;
+	// Whether the level given on the command line, or a generated one, could be set up.
+	bool level_loaded_;
 	bool running_;
+	int benchmark_ticks_;
+	int maze_col_count_;
+	int maze_row_count_;
+	// Seed of the next generated maze, counted up by every one.
+	std::uint32_t maze_seed_;
+	int maze_chunk_size_;
+	const char* convert_path_;
+	std::size_t chunk_memory_budget_;
 
 	std::unique_ptr<Level> level_;
 	std::unique_ptr<Player> player_;
 	std::unique_ptr<Screen> screen_;
 	std::vector<std::unique_ptr<Texture>> textures_;
+	std::unique_ptr<ThreadPool> thread_pool_;
 	
 	bool map_toggled_;
 	bool fisheye_effect_toggled_;
 	bool textures_toggled_;
+	bool parallel_toggled_;
+	bool packets_toggled_;
+	bool skipping_toggled_;
+	bool hierarchical_toggled_;
+	bool mipmaps_toggled_;
+	bool fog_toggled_;
+	bool floor_toggled_;
+	bool dynamic_resolution_toggled_;
+	bool adaptive_toggled_;
+	bool temporal_cache_toggled_;
+	bool full_clear_toggled_;
+	bool stats_toggled_;
+
+	ResolutionController resolution_controller_;
 
 	SDL_Window* window_;
 	SDL_Renderer* renderer_;
 	
 public:
-	Game();
+	Game(const Options& options);
 
 	~Game();
 
 	bool InitializeSDL();
 
+	// Sets up only what reading level images takes, for --convert.
+	bool InitializeConverter();
+
 	void Finalize();
 
-	void Run();
+	// Returns the process's exit status.
+	int Run();
+
+	void RunBenchmark();
 
 	void HandleEvents();
 	
@@ -51,9 +86,14 @@ public:
 	
 	void Render();
 
+	// Replaces the level with the next maze, carved in chunks if maze_chunk_size_ is set.
+	void GenerateMaze();
+
 	std::uint32_t GetColor(const SDL_Color& color);
 
 	bool ColorsEqual(const SDL_Color& color1, const SDL_Color& color2);
+
+	Texture* GetWallTexture(const SDL_Color& color);
 };
 
 #endif
\ No newline at end of file
@@ -1,22 +1,32 @@
 #ifndef LEVEL_HPP
 #define LEVEL_HPP
 
+#include "Constants.hpp"
+#include "LevelChunks.hpp"
 #include "Vect2d.hpp"
 
 #include <SDL2/SDL.h>
 
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <random>
 #include <vector>
 
 struct Tile
 {
-	SDL_Rect rect_;
 	bool is_wall_;
 	SDL_Color color_;
-	bool visited_;
 };
 
 class Game;
+class LevelFile;
+class Minimap;
 class Screen;
+class Texture;
+
+// Tiles at least this far from the nearest wall let the DDA jump instead of stepping.
+inline constexpr int min_skip_distance = 3;
   
 class Level
 {
@@ -27,10 +37,38 @@ private:
 	Uint32* pixels_;
 
 	std::vector<Tile> board_;
+	std::unique_ptr<Minimap> minimap_;
+
+	// Compact copy of board_ for the ray marchers: one wall bit and one material id per tile, 
+	// padded with a solid one-tile border so lookups never need bounds checks. The pointers lead into 
+	// the owned_ vectors for boards built here and into the mapped file for binary levels.
+	const std::uint32_t* wall_bits_;
+	const std::uint8_t* materials_;
+	std::vector<std::uint32_t> owned_wall_bits_;
+	std::vector<std::uint8_t> owned_materials_;
+	std::vector<SDL_Color> material_colors_;
+	// Wall texture per material id, resolved once when the material is first seen; nullptr for untextured ones.
+	std::vector<Texture*> material_textures_;
+	// Flat colour per material and shade, laid out like the shades of a Texture.
+	std::vector<std::uint32_t> material_shades_;
+	// Chebyshev distance from every tile to the nearest wall, capped at UINT8_MAX.
+	const std::uint8_t* distances_;
+	std::vector<std::uint8_t> owned_distances_;
+	// Occupancy pyramid over the padded grid: entry k holds one bit per 4^(k + 1) square block, set if the block has a wall.
+	std::vector<const std::uint32_t*> pyramid_bits_;
+	std::vector<std::vector<std::uint32_t>> owned_pyramid_bits_;
+	std::vector<int> pyramid_col_counts_;
+	std::unique_ptr<LevelFile> file_;
+	// Set for chunked levels, which leave all of the above empty and read tiles through it instead. 
+	// They have no occupancy pyramid and no flat wall bits for the packet tracer.
+	std::unique_ptr<LevelChunkStore> chunks_;
+	int padded_col_count_;
+	// Bumped by every board change, so whatever was derived from an older board can tell it is stale.
+	std::uint64_t generation_;
 
 	int tiles_col_count_;
 	int tiles_row_count_;
-	int tiles_count_;
+	std::int64_t tiles_count_;
 	int tile_size_;
 
 public:
@@ -40,19 +78,68 @@ public:
 
 	void HandleEvents();
 	
-	void Tick();
+	// Draws the minimap, following focus.
+	void Tick(const Vect2d<float>& focus);
 	
 	bool Load(const char* path);
 
+	// Builds the board from a level image, or maps it from a binary level if the path ends in level_file_extension.
 	bool Initialize(const char* path);
 
-	void GenerateMazeHuntAndKill();
+	// Maps a binary level written by Save(); nothing is copied or derived, whatever the size of the map.
+	bool LoadLevelFile(const char* path);
+
+	// Opens a chunked level, which is read from disk while it is played and never wholly held in memory.
+	bool LoadLevelChunks(const char* path);
+
+	// Writes the current board as a binary level, or as a chunked level if the path ends in level_chunk_file_extension.
+	bool Save(const char* path);
+
+	bool SaveChunks(const char* path);
+
+	// Replaces the material table with colours from a level file and resolves their textures and shades.
+	void SetMaterialColors(const SDL_Color* colors, std::size_t count);
+
+	// Replaces the board with a maze of at least col_count x row_count tiles, rounded up to odd sides.
+	void GenerateMazeHuntAndKill(int col_count, int row_count, std::uint32_t seed);
+
+	// Like GenerateMazeHuntAndKill(), but carves chunks of chunk_size x chunk_size cells on the thread pool and joins 
+	// neighbouring chunks through single passages. The maze depends on the seed and chunk size, not the thread count.
+	void GenerateMazeChunked(int col_count, int row_count, std::uint32_t seed, int chunk_size);
+
+	// Walls in a board of at least col_count x row_count tiles for the maze generators.
+	void ResetMazeBoard(int col_count, int row_count);
+
+	// Hunt-and-kill over the cells of a walled-in rectangle, given in cells of two tiles, leaving its edges closed.
+	void CarveMaze(const SDL_Rect& cells, std::mt19937& random);
+
+	// Fills neighbor_indices with the cells of the rectangle two tiles away from the cell at index and returns how many there are.
+	int GetNeighborTilesIndices(int index, const SDL_Rect& cells, std::array<int, 4>& neighbor_indices);
+
+	// Opens a tile without telling the minimap, for generators that rebuild the whole board.
+	void OpenTile(std::size_t index);
+
+	// Opens the wall tile at x, y and updates the wall bits, distances and pyramid blocks around it instead of rebuilding them. 
+	// Mapped and chunked levels are read-only; returns whether the tile was opened.
+	bool DeleteWall(int x, int y);
+
+	void BoardChanged();
+
+	void BuildOccupancy();
+
+	void BuildDistanceField();
+
+	// Runs the distance transform over a rectangle of tiles, seeded by the distances of the tiles around it.
+	void UpdateDistances(const SDL_Rect& tiles);
+
+	void BuildPyramid();
 
-	std::vector<int> GetNeighborTilesIndices(int index);
+	// Clears the pyramid blocks over an opened tile that no longer hold a wall.
+	void UpdatePyramid(int x, int y);
 
-	bool BoardComplete();
+	std::uint8_t GetMaterialIndex(const SDL_Color& color);
 
-	void DeleteWall(std::size_t index);
+	void AddMaterialShades(const SDL_Color& color);
 
 	void Free();
 
@@ -60,7 +147,7 @@ public:
 	
 	int GetRowCount();
 	
-	int GetPixelCount();
+	std::int64_t GetPixelCount();
 
 	int GetTileSize();
 	
@@ -70,7 +157,82 @@ public:
 
 	Uint32 GetPitch32();
 
-	Tile* GetTile(int x, int y);
+	Minimap& GetMinimap();
+
+	// Valid for -1 <= x <= GetColumnCount() and -1 <= y <= GetRowCount(); padded grids are kept within constants::max_padded_tile_count.
+	int GetPaddedIndex(int x, int y) const
+	{
+		return (y + 1) * padded_col_count_ + (x + 1);
+	}
+
+	bool IsStreamed() const
+	{
+		return chunks_ != nullptr;
+	}
+
+	LevelChunkStore* GetChunkStore() const
+	{
+		return chunks_.get();
+	}
+
+	bool IsWall(int x, int y) const
+	{
+		if (chunks_ != nullptr)
+		{
+			return chunks_->IsWall(x, y);
+		}
+
+		const int index = GetPaddedIndex(x, y);
+		return (wall_bits_[index >> 5] >> (index & 31)) & 1;
+	}
+
+	std::uint8_t GetMaterial(int x, int y) const
+	{
+		if (chunks_ != nullptr)
+		{
+			return chunks_->GetMaterial(x, y);
+		}
+
+		return materials_[GetPaddedIndex(x, y)];
+	}
+
+	int GetDistance(int x, int y) const
+	{
+		if (chunks_ != nullptr)
+		{
+			return chunks_->GetDistance(x, y);
+		}
+
+		return distances_[GetPaddedIndex(x, y)];
+	}
+
+	const SDL_Color& GetMaterialColor(std::uint8_t material) const
+	{
+		return material_colors_[material];
+	}
+
+	Texture* GetMaterialTexture(std::uint8_t material) const
+	{
+		return material_textures_[material];
+	}
+
+	std::uint32_t GetMaterialShade(std::uint8_t material, int shade) const
+	{
+		return material_shades_[material * 2 * constants::fog_level_count + shade];
+	}
+
+	bool GetEmptyReach(int x, int y, int step_x, int step_y, bool use_distances, bool use_pyramid, int& reach_x, int& reach_y) const;
+
+	int GetMaxRaySteps() const;
+
+	std::uint64_t GetGeneration() const
+	{
+		return generation_;
+	}
+
+	const std::uint32_t* GetWallBits() const;
+
+	int GetPaddedColumnCount() const;
 
 	// std::vector<Tile*> GetNeighborTiles(int x, int y);
 
@@ -0,0 +1,117 @@
+#ifndef LEVEL_CHUNKS_HPP
+#define LEVEL_CHUNKS_HPP
+
+#include <SDL2/SDL.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Side of a chunk in tiles; a power of two, so tiles find their chunk with shifts.
+inline constexpr int level_chunk_shift = 6;
+inline constexpr int level_chunk_size = 1 << level_chunk_shift;
+inline constexpr char level_chunk_file_extension[] = ".lvc";
+// Longest side of a chunked level; far more than a disk holds, and small enough that sums of sides stay ints.
+inline constexpr int level_chunk_max_side = 1 << 24;
+
+// The ray data of level_chunk_size x level_chunk_size tiles, stored on disk exactly like this.
+// Tiles of chunks hanging over the map's edge are walls.
+struct LevelChunk
+{
+	std::uint32_t wall_bits_[level_chunk_size * level_chunk_size / 32];
+	std::uint8_t materials_[level_chunk_size * level_chunk_size];
+	std::uint8_t distances_[level_chunk_size * level_chunk_size];
+};
+
+// Start of a chunked level: the material colours, then every chunk row by row.
+struct LevelChunkFileHeader
+{
+	char magic_[4];
+	std::uint32_t version_;
+	std::int32_t col_count_;
+	std::int32_t row_count_;
+	std::uint32_t material_count_;
+	std::uint32_t chunk_size_;
+	std::uint64_t material_colors_offset_;
+	std::uint64_t chunks_offset_;
+};
+
+inline constexpr char level_chunk_file_magic[4] = { 'R', 'C', 'L', 'C' };
+inline constexpr std::uint32_t level_chunk_file_version = 1;
+
+// A chunked level read from disk as the tiles are looked at. At most as many chunks as fit into the memory budget
+// stay loaded, dropping the least recently used ones first. Lookups go through a small cache of chunks on every
+// thread, so they only take the lock when they move onto a chunk their thread has not read lately, and disk reads
+// never hold it.
+class LevelChunkStore
+{
+private:
+	std::FILE* file_;
+	LevelChunkFileHeader header_;
+	std::vector<SDL_Color> material_colors_;
+	int chunk_col_count_;
+	int chunk_row_count_;
+	std::size_t max_resident_count_;
+	// Tells the thread caches of different stores apart.
+	std::uint64_t id_;
+
+	// Serialises reads where there is no pread, since they share the file position.
+	std::mutex file_mutex_;
+
+	std::mutex mutex_;
+	// Loaded chunks, most recently used first, and where each one is in the list.
+	std::list<std::pair<int, std::shared_ptr<const LevelChunk>>> resident_;
+	std::unordered_map<int, std::list<std::pair<int, std::shared_ptr<const LevelChunk>>>::iterator> resident_index_;
+	std::atomic<std::uint64_t> load_count_;
+	// Chunks put at the front of resident_ so far, which tells the thread caches how far down the list their chunks have moved.
+	std::atomic<std::uint64_t> insert_count_;
+
+	std::shared_ptr<const LevelChunk> LoadChunk(int chunk_index);
+
+	bool ReadChunk(int chunk_index, LevelChunk& chunk);
+
+	// Moves a chunk to the front of resident_, adding it if it was dropped meanwhile. Called with mutex_ held.
+	void UseChunk(int chunk_index, const std::shared_ptr<const LevelChunk>& chunk);
+
+	// Marks a chunk a thread cache still reads as used, so it is not dropped under it.
+	void TouchChunk(int chunk_index, const std::shared_ptr<const LevelChunk>& chunk);
+
+	const LevelChunk& GetChunk(int x, int y);
+
+public:
+	LevelChunkStore();
+
+	~LevelChunkStore();
+
+	LevelChunkStore(const LevelChunkStore&) = delete;
+
+	LevelChunkStore& operator=(const LevelChunkStore&) = delete;
+
+	bool Open(const char* path, std::size_t memory_budget);
+
+	int GetColumnCount() const;
+
+	int GetRowCount() const;
+
+	const std::vector<SDL_Color>& GetMaterialColors() const;
+
+	// Tiles outside the map read as the solid, material 0 border the padded grids have.
+	bool IsWall(int x, int y);
+
+	std::uint8_t GetMaterial(int x, int y);
+
+	int GetDistance(int x, int y);
+
+	std::size_t GetResidentCount();
+
+	std::uint64_t GetLoadCount() const;
+};
+
+#endif
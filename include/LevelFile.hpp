@@ -0,0 +1,69 @@
+#ifndef LEVEL_FILE_HPP
+#define LEVEL_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Start of a binary level: everything Level derives from a level image, laid out so it can be used in place.
+// Every section starts at a multiple of level_file_alignment; offsets count from the start of the file.
+struct LevelFileHeader
+{
+	char magic_[4];
+	std::uint32_t version_;
+	std::int32_t col_count_;
+	std::int32_t row_count_;
+	std::uint32_t material_count_;
+	std::uint32_t reserved_;
+	// RGBA bytes per material id.
+	std::uint64_t material_colors_offset_;
+	// Wall bits, material ids and wall distances over the padded grid, as Level keeps them.
+	std::uint64_t wall_bits_offset_;
+	std::uint64_t materials_offset_;
+	std::uint64_t distances_offset_;
+	// The occupancy pyramid's levels back to back, each padded to whole sections.
+	std::uint64_t pyramid_offset_;
+	std::uint64_t file_size_;
+};
+
+inline constexpr char level_file_magic[4] = { 'R', 'C', 'L', 'V' };
+inline constexpr std::uint32_t level_file_version = 1;
+inline constexpr std::size_t level_file_alignment = 64;
+inline constexpr char level_file_extension[] = ".lvl";
+
+inline std::uint64_t AlignLevelFileOffset(std::uint64_t offset)
+{
+	return (offset + level_file_alignment - 1) / level_file_alignment * level_file_alignment;
+}
+
+// A binary level mapped read-only into memory, so opening it costs the same for every map size and processes
+// showing the same level share its pages. Where mmap is not available the file is read into memory instead.
+class LevelFile
+{
+private:
+	const std::uint8_t* data_;
+	std::size_t size_;
+	std::vector<std::uint8_t> buffer_;
+
+public:
+	LevelFile();
+
+	~LevelFile();
+
+	LevelFile(const LevelFile&) = delete;
+
+	LevelFile& operator=(const LevelFile&) = delete;
+
+	// Maps the file and checks its header and that every section lies inside it.
+	bool Open(const char* path);
+
+	void Close();
+
+	const LevelFileHeader& GetHeader() const;
+
+	const std::uint8_t* GetData(std::uint64_t offset) const;
+
+	std::uint64_t GetSize() const;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef MINIMAP_HPP
+#define MINIMAP_HPP
+
+#include "Bitmap.hpp"
+#include "Vect2d.hpp"
+
+#include <SDL2/SDL.h>
+
+#include <memory>
+#include <vector>
+
+class Game;
+class Level;
+
+// The minimap, drawn over the top-left corner of the view: a window of tiles rasterised once into a layer
+// of its own and copied into every frame. Only tiles that change or scroll into the window are drawn again.
+class Minimap
+{
+private:
+	Game* game_;
+	Level* level_;
+
+	std::unique_ptr<Bitmap> layer_;
+	// Pixels per tile.
+	int zoom_;
+	// Tile in the window's top-left corner and the window's size in pixels, as the layer holds them.
+	int origin_x_;
+	int origin_y_;
+	int window_width_;
+	int window_height_;
+	// Set when the whole board changed; dirty_tiles_ lists the single tiles that did since the last Draw().
+	bool stale_;
+	std::vector<int> dirty_tiles_;
+
+public:
+	Minimap(Game* game, Level* level);
+
+	void Invalidate();
+
+	void MarkTileDirty(int tile_x, int tile_y);
+
+	void ZoomIn();
+
+	void ZoomOut();
+
+	int GetZoom();
+
+	// Size of the window on a view of the given size: the whole level where it fits, or a corner of the view where it does not.
+	int GetWindowWidth(int view_width);
+
+	int GetWindowHeight(int view_height);
+
+	// Brings the layer up to date for a window that follows focus, then copies it into the target.
+	void Draw(Bitmap& target, const Vect2d<float>& focus);
+
+	// Where a point of the level ends up in the last drawn window.
+	Vect2d<float> GetScreenPosition(const Vect2d<float>& point);
+
+	void DrawTile(int tile_x, int tile_y);
+
+	// Draws the tiles of the window that are not in kept, the tiles the layer still holds.
+	void DrawTiles(const SDL_Rect& kept);
+
+	// Moves the layer's pixels for a window origin delta tiles further on.
+	void ScrollLayer(int delta_x, int delta_y);
+};
+
+#endif
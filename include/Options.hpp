@@ -0,0 +1,31 @@
+#ifndef OPTIONS_HPP
+#define OPTIONS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+struct Options
+{
+	std::size_t thread_count_;
+	const char* level_path_;
+	// Ticks rendered per benchmark scenario; 0 runs the game interactively.
+	int benchmark_ticks_;
+	// Frame time the dynamic resolution mode aims for.
+	double target_frame_ms_;
+	// Size and first seed of the mazes 'g' generates.
+	int maze_col_count_;
+	int maze_row_count_;
+	std::uint32_t maze_seed_;
+	// Side of the chunks mazes are carved in in parallel, in cells; 0 carves them in one piece.
+	int maze_chunk_size_;
+	// Starts in a generated maze instead of the level image.
+	bool generate_maze_;
+	// Memory chunked levels may keep loaded, in bytes.
+	std::size_t chunk_memory_budget_;
+	// Writes the level to this binary level file instead of starting the game; nullptr to play.
+	const char* convert_path_;
+};
+
+Options ParseOptions(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef PACKET_TRACER_HPP
+#define PACKET_TRACER_HPP
+
+#include "Vect2d.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+class Level;
+
+struct TraceSettings
+{
+	bool skipping_;
+	bool hierarchical_;
+};
+
+struct RayHit
+{
+	int map_x_;
+	int map_y_;
+	int wall_side_;
+	int steps_;
+	// Distance to the hit along the ray, in units of the ray direction's length.
+	double distance_;
+};
+
+// Number of grid lines, spaced ray_step_size apart from ray_length onwards, that a ray crosses before skip_length.
+template <typename T>
+int CountSkippedCrossings(T ray_length, T ray_step_size, T skip_length, int max_crossings)
+{
+	if (!(ray_length < skip_length))
+	{
+		return 0;
+	}
+
+	return std::min(max_crossings, static_cast<int>(std::ceil((skip_length - ray_length) / ray_step_size)));
+}
+
+// Jumps a DDA state over every grid crossing before the ray leaves the empty box described by 
+// reach_x and reach_y, the number of grid lines it may cross on each axis (see Level::GetEmptyReach).
+template <typename T, typename I>
+void SkipCrossings(int reach_x, int reach_y, T ray_step_size_x, T ray_step_size_y, I step_x, I step_y, T& ray_length_x, T& ray_length_y, I& map_x, I& map_y)
+{
+	const T exit_x = reach_x == 0 ? ray_length_x : ray_length_x + reach_x * ray_step_size_x;
+	const T exit_y = reach_y == 0 ? ray_length_y : ray_length_y + reach_y * ray_step_size_y;
+	const T skip_length = std::min(exit_x, exit_y);
+	const int crossings_x = CountSkippedCrossings(ray_length_x, ray_step_size_x, skip_length, reach_x);
+	const int crossings_y = CountSkippedCrossings(ray_length_y, ray_step_size_y, skip_length, reach_y);
+
+	ray_length_x += crossings_x * ray_step_size_x;
+	map_x += crossings_x * step_x;
+	ray_length_y += crossings_y * ray_step_size_y;
+	map_y += crossings_y * step_y;
+}
+
+// Marches a packet of neighbouring rays through the level together, one SIMD lane per ray.
+class PacketTracer
+{
+public:
+#if defined(__AVX2__)
+	static constexpr int lane_count = 8;
+#elif defined(__SSE2__)
+	static constexpr int lane_count = 4;
+#else
+	static constexpr int lane_count = 1;
+#endif
+
+	// Once this few lanes are still marching, the rest of the packet is finished one ray at a time.
+	static constexpr int straggler_count = lane_count / 4;
+
+private:
+	// Structure-of-arrays view of a packet, laid out so each field loads straight into a register.
+	struct Packet
+	{
+		alignas(32) float ray_length_x_[lane_count];
+		alignas(32) float ray_length_y_[lane_count];
+		alignas(32) float ray_step_size_x_[lane_count];
+		alignas(32) float ray_step_size_y_[lane_count];
+		alignas(32) std::int32_t step_x_[lane_count];
+		alignas(32) std::int32_t step_y_[lane_count];
+		alignas(32) std::int32_t map_x_[lane_count];
+		alignas(32) std::int32_t map_y_[lane_count];
+		alignas(32) std::int32_t wall_side_[lane_count];
+		alignas(32) std::int32_t steps_[lane_count];
+		alignas(32) std::int32_t active_[lane_count];
+	};
+
+	Level* level_;
+
+	bool IsWall(int x, int y);
+
+	void MarchPacket(Packet& packet, int& active_mask);
+
+	void FinishLane(Packet& packet, int lane, const TraceSettings& settings);
+
+public:
+	PacketTracer(Level* level);
+
+	void TracePacket(const Vect2d<float>& origin, const float* ray_dirs_x, const float* ray_dirs_y, int count, const TraceSettings& settings, RayHit* hits);
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef PERF_COUNTER_HPP
+#define PERF_COUNTER_HPP
+
+#include <cstdint>
+
+// Hardware cache-miss counter for the calling thread, read through perf_event_open on Linux.
+// Elsewhere, or when the kernel refuses access, IsAvailable() is false and Stop() returns 0.
+class CacheMissCounter
+{
+private:
+	int fd_;
+
+public:
+	CacheMissCounter();
+
+	~CacheMissCounter();
+
+	CacheMissCounter(const CacheMissCounter&) = delete;
+
+	CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+	bool IsAvailable() const;
+
+	void Start();
+
+	std::uint64_t Stop();
+};
+
+#endif
@@ -1,15 +1,53 @@
 #ifndef PLAYER_HPP
 #define PLAYER_HPP
 
+#include "Camera.hpp"
+#include "FixedPoint.hpp"
+#include "PacketTracer.hpp"
 #include "Vect2d.hpp"
 
 #include <SDL2/SDL.h>
 
+#include <cstdint>
+#include <vector>
+
 class Game;
 class Level;
 class Screen;
 struct Tile;
 
+// Scalar type the ray pass traverses the grid in: built with RAYCAST_FIXED_POINT (make FIXED_POINT=1), 
+// the integer 16.16 backend instead of double precision.
+#if defined(RAYCAST_FIXED_POINT)
+using RayScalar = Fixed16;
+#else
+using RayScalar = double;
+#endif
+
+// Per-worker state for the ray pass, padded so workers never share a cache line.
+struct alignas(64) RayScratch
+{
+	std::uint64_t rays_cast_;
+	std::uint64_t dda_steps_;
+	std::uint64_t columns_drawn_;
+	std::uint64_t rays_seeded_;
+	std::uint64_t frames_reused_;
+	std::uint64_t strips_drawn_;
+	std::uint64_t pixels_cleared_;
+};
+
+// The camera and settings a frame was cast with; the temporal cache compares them with the next frame's.
+struct CachedView
+{
+	Vect2d<float> position_;
+	Vect2d<float> direction_;
+	Vect2d<float> plane_;
+	int view_width_;
+	int view_height_;
+	std::uint64_t level_generation_;
+	std::uint32_t settings_;
+};
+
 class Player
 {
 private:
@@ -29,6 +67,28 @@ private:
 	bool moving_forwards_; 
 	bool moving_backwards_;
 
+	Camera camera_;
+	PacketTracer packet_tracer_;
+	std::vector<RayScratch> ray_scratch_;
+	// Screen rows [wall_tops_[x], wall_bottoms_[x]) of column x hold wall this frame; the floor pass fills the rest.
+	std::vector<int> wall_tops_;
+	std::vector<int> wall_bottoms_;
+	// Size of the 3D view this frame, which dynamic resolution may set below the screen size.
+	int view_width_;
+	int view_height_;
+
+	// Temporal cache: the hit of every column this frame and the last cast one, and the view the latter was cast from.
+	std::vector<RayHit> hits_;
+	std::vector<RayHit> previous_hits_;
+	// Number of edges between faces that this frame's translation can move across each column; 
+	// only columns no edge reaches may seed their ray with the last hit.
+	std::vector<int> edge_coverage_;
+	CachedView cached_view_;
+	bool cache_valid_;
+	bool reuse_frame_;
+	bool seed_from_cache_;
+	double seed_translation_;
+
 public:
 	Player(Game* game, Screen* screen, Level* level);
 
@@ -40,11 +100,64 @@ public:
 	
 	void Tick();
 
+	bool PrepareFrame();
+
+	CachedView GetCurrentView();
+
 	Vect2d<float> RotatePoint(const Vect2d<float>& rotating_point, const Vect2d<float>& pivot, int degrees);
 
 	void CastRayLines();
 
-	void DigitalDifferentialAnalysis(int x, Vect2d<double> ray_dir);
+	void CastRayBand(int begin_x, int end_x, RayScratch& scratch);
+
+	void FindSeedableColumns();
+
+	int GetEdgeReach(double distance);
+
+	double GetWallClearance();
+
+	bool GetCachedHit(int x, const Vect2d<double>& ray_dir, RayHit& hit);
+
+	void CastRayPackets(int begin_x, int end_x, RayScratch& scratch);
+
+	void CastRaysAdaptive(int begin_x, int end_x, RayScratch& scratch);
+
+	void RefineColumns(int segment_begin, int low, int high, Vect2d<double>* ray_dirs, RayHit* hits, RayScratch& scratch);
+
+	RayHit CastAdaptiveRay(const Vect2d<double>& ray_dir, RayScratch& scratch);
+
+	bool HitsShareFace(const RayHit& hit1, const RayHit& hit2);
+
+	RayHit GetFaceHit(const Vect2d<double>& ray_dir, const RayHit& face);
+
+	void CastFloorRows(int begin_y, int end_y, RayScratch& scratch);
+
+	void ClearFloorRows(int begin_y, int end_y, RayScratch& scratch);
+
+	int GetMapCoverWidth(int y);
+
+	TraceSettings GetTraceSettings();
+
+	Vect2d<double> GetRayDirection(int x);
+
+	int GetViewPitch();
+
+	int GetFogLevel(double distance);
+
+	Vect2d<double> GetRayStepSize(const Vect2d<double>& ray_dir);
+
+	template <typename T = RayScalar>
+	RayHit DigitalDifferentialAnalysis(const Vect2d<double>& ray_dir);
+
+	void DrawWallStrips(int begin_x, int end_x, RayScratch& scratch);
+
+	void DrawWallStrip(int begin_x, int end_x, RayScratch& scratch);
+
+	RayScratch CollectRayStats();
+
+	void ComparePacketTracer();
+
+	void CompareDdaBackends(int frames);
 };
 
 #endif
\ No newline at end of file
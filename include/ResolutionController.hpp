@@ -0,0 +1,35 @@
+#ifndef RESOLUTION_CONTROLLER_HPP
+#define RESOLUTION_CONTROLLER_HPP
+
+// Picks the resolution of the 3D view that keeps the frame time within a budget. The view is scaled 
+// in steps of 1 / scale_steps of the screen size, and frame times are smoothed so one slow frame 
+// does not change the resolution.
+class ResolutionController
+{
+private:
+	double target_frame_ms_;
+	double average_frame_ms_;
+	int scale_step_;
+	int settle_frames_;
+	bool measured_;
+
+public:
+	static constexpr int scale_steps = 16;
+	static constexpr int min_scale_step = 4;
+
+	ResolutionController(double target_frame_ms);
+
+	void Reset();
+
+	void Update(double frame_ms);
+
+	double GetScale() const;
+
+	int Scale(int size) const;
+
+	double GetAverageFrameMs() const;
+
+	double GetTargetFrameMs() const;
+};
+
+#endif
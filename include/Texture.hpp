@@ -3,7 +3,9 @@
 
 #include <SDL2/SDL.h>
 
+#include <algorithm>
 #include <cstdint>
+#include <vector>
 
 class Game;
 
@@ -14,6 +16,13 @@ private:
     SDL_Texture* texture_;
     SDL_Surface* surface_;
 
+    // Transposed copy of the loaded pixels so a wall column samples one contiguous run, followed by 
+    // its mip chain (each level a 2x2 box filter of the previous one, stored the same way).
+    // The whole chain is then repeated once per shade, see GetShadeIndex().
+    std::vector<std::uint32_t> columns_;
+    std::vector<std::size_t> mip_offsets_;
+    std::size_t shade_size_;
+
 public:
     std::size_t width_;
     std::size_t height_;
@@ -34,6 +43,40 @@ public:
 
     std::uint32_t GetPitch32();
 
+    int GetMipCount() const
+    {
+        return static_cast<int>(mip_offsets_.size());
+    }
+
+    std::size_t GetMipWidth(int level) const
+    {
+        return std::max<std::size_t>(width_ >> level, 1);
+    }
+
+    std::size_t GetMipHeight(int level) const
+    {
+        return std::max<std::size_t>(height_ >> level, 1);
+    }
+
+    // Column x of mip level 'level' in the given shade, where x is already in that level's texels.
+    const std::uint32_t* GetColumn32(int x, int level = 0, int shade = 0) const
+    {
+        return columns_.data() + shade * shade_size_ + mip_offsets_[level] + x * GetMipHeight(level);
+    }
+
+    // Shades are the distance fog levels, each in a lit and a darkened (side-facing wall) variant.
+    static int GetShadeIndex(int fog_level, bool darkened)
+    {
+        return fog_level * 2 + (darkened ? 1 : 0);
+    }
+
+    static std::uint32_t ShadeTexel(std::uint32_t texel, int shade);
+
+private:
+    void BuildMipChain();
+
+    void BuildShades();
+
     std::uint32_t MapRGBA(std::uint8_t r, std::uint8_t g, std::uint8_t b, std::uint8_t a);
 };
 
@@ -0,0 +1,51 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	// Called with a half-open band [band_begin, band_end) and the index of the worker running it.
+	using Job = std::function<void(int band_begin, int band_end, std::size_t worker_index)>;
+
+private:
+	std::vector<std::thread> workers_;
+	std::mutex mutex_;
+	std::condition_variable work_available_;
+	std::condition_variable work_done_;
+
+	const Job* job_;
+	int job_end_;
+	int band_size_;
+	std::atomic<int> next_band_begin_;
+	std::size_t generation_;
+	std::size_t pending_workers_;
+	bool stopping_;
+
+	void WorkerLoop(std::size_t worker_index);
+
+	void RunBands(std::size_t worker_index);
+
+public:
+	// thread_count includes the calling thread, which always works as worker 0.
+	ThreadPool(std::size_t thread_count);
+
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	std::size_t GetThreadCount();
+
+	void ParallelFor(int begin, int end, int band_size, const Job& job);
+};
+
+#endif
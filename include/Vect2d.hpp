@@ -12,6 +12,10 @@ public:
 	T x_;
 	T y_;
 
+	Vect2d() : x_(0), y_(0)
+	{
+	}
+
 	Vect2d(T x, T y) : x_(x), y_(y)
 	{
 	}
@@ -30,7 +34,7 @@ public:
 		y_ *= length;
 	}
 
-	T GetLength()
+	T GetLength() const
 	{
 		return std::sqrt((x_ * x_) + (y_ * y_));
 	}
@@ -0,0 +1,26 @@
+#ifndef WALL_SPAN_HPP
+#define WALL_SPAN_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// One textured wall column: screen row begin_y + i shows texel (tex_pos_ + i * tex_step_) of the 
+// texture column texels_, which is texture_height_ texels tall and wraps around. The position is 
+// stepped by repeated addition, so every kernel samples exactly the same texels.
+struct WallSpan
+{
+	const std::uint32_t* texels_;
+	double tex_pos_;
+	double tex_step_;
+	int texture_height_;
+};
+
+// Draws rows [begin_y, end_y) of a span into a column whose pixel y is at column[y * stride].
+using WallSpanKernel = void (*)(const WallSpan& span, std::uint32_t* column, std::ptrdiff_t stride, int begin_y, int end_y);
+
+// Kernel specialised for the target's layout and how the span wraps, picked once per column before its 
+// row_count rows are drawn: contiguous columns (the column-major target), spans that stay within one 
+// repeat of the texture and need no wrap, and power-of-two heights, which wrap with a mask.
+WallSpanKernel GetWallSpanKernel(bool contiguous, const WallSpan& span, int row_count);
+
+#endif
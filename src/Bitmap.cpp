@@ -2,164 +2,435 @@
 
 #include <SDL2/SDL.h>
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <new>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+#if defined(__AVX__)
+    constexpr int transpose_block = 8;
+
+    void TransposeBlock(const std::uint32_t* src, std::size_t src_stride, std::uint32_t* dst, std::size_t dst_stride)
+    {
+        __m256 r[8];
+
+        for (int i = 0; i < 8; ++i)
+        {
+            r[i] = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * src_stride)));
+        }
+
+        const __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+        const __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+        const __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+        const __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+        const __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+        const __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+        const __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+        const __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+        const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        const __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        const __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+        const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+        const __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+        const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+        const __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+        r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+        r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+        r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+        r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+        r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+        r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+        r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+        r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+
+        for (int i = 0; i < 8; ++i)
+        {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * dst_stride), _mm256_castps_si256(r[i]));
+        }
+    }
+#elif defined(__SSE2__)
+    constexpr int transpose_block = 4;
+
+    void TransposeBlock(const std::uint32_t* src, std::size_t src_stride, std::uint32_t* dst, std::size_t dst_stride)
+    {
+        __m128 r0 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+        __m128 r1 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + src_stride)));
+        __m128 r2 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * src_stride)));
+        __m128 r3 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * src_stride)));
+
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_castps_si128(r0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + dst_stride), _mm_castps_si128(r1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * dst_stride), _mm_castps_si128(r2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * dst_stride), _mm_castps_si128(r3));
+    }
+#else
+    constexpr int transpose_block = 1;
+
+    void TransposeBlock(const std::uint32_t* src, std::size_t src_stride, std::uint32_t* dst, std::size_t dst_stride)
+    {
+        (void) src_stride;
+        (void) dst_stride;
+        *dst = *src;
+    }
+#endif
+
+    constexpr int transpose_strip_width = 32;
+
+    // Rows start on cache-line boundaries so streamed row runs cover whole lines instead of splitting them.
+    constexpr std::align_val_t pixel_alignment{64};
+
+    std::uint32_t* AllocatePixels(std::size_t count)
+    {
+        return static_cast<std::uint32_t*>(::operator new[](count * sizeof(std::uint32_t), pixel_alignment));
+    }
+
+    void FreePixels(std::uint32_t* pixels)
+    {
+        ::operator delete[](pixels, pixel_alignment);
+    }
+
+    void FillRow(std::uint32_t* dst, int count, std::uint32_t color)
+    {
+        int i = 0;
+
+#if defined(__AVX__)
+        const __m256i colors = _mm256_set1_epi32(static_cast<int>(color));
+
+        for (; i + 8 <= count; i += 8)
+        {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), colors);
+        }
+#elif defined(__SSE2__)
+        const __m128i colors = _mm_set1_epi32(static_cast<int>(color));
+
+        for (; i + 4 <= count; i += 4)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), colors);
+        }
+#endif
+
+        for (; i < count; ++i)
+        {
+            dst[i] = color;
+        }
+    }
+
+    // Which edges of the view a point lies beyond, for clipping lines.
+    constexpr int outcode_left = 1;
+    constexpr int outcode_right = 2;
+    constexpr int outcode_top = 4;
+    constexpr int outcode_bottom = 8;
+
+    void StreamRow(const std::uint32_t* src, std::uint32_t* dst, int count)
+    {
+        int i = 0;
+
+#if defined(__SSE2__)
+        if (reinterpret_cast<std::uintptr_t>(dst) % 16 == 0)
+        {
+            for (; i + 4 <= count; i += 4)
+            {
+                _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i), _mm_load_si128(reinterpret_cast<const __m128i*>(src + i)));
+            }
+        }
+#endif
+
+        for (; i < count; ++i)
+        {
+            dst[i] = src[i];
+        }
+    }
+} // namespace
 
 Bitmap::Bitmap(SDL_Renderer* renderer, std::size_t width, std::size_t height) : 
     renderer_(renderer), 
+    columns_(nullptr), 
+    column_major_(false), 
+    view_width_(static_cast<int>(width)), 
+    view_height_(static_cast<int>(height)), 
+    buffer_(nullptr), 
+    locked_(false), 
+    lock_supported_(true), 
+    frame_drawn_(false), 
     width_(width), 
-    height_(height)
+    height_(height), 
+    pitch_(width)
 {
-    pixels_ = new std::uint32_t[width_ * height_];
+    buffer_ = AllocatePixels(width_ * height_);
 
     for (std::size_t i = 0; i < width_ * height_; ++i)
  	{
- 		pixels_[i] = 0;
+ 		buffer_[i] = 0;
  	}
 
+    pixels_ = buffer_;
+    texture_ = nullptr;
+
+    if (renderer_ == nullptr)
+    {
+        return;
+    }
+
     texture_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width_, height_);
 
     //SDL_SetTextureBlendMode(texture_, SDL_BLENDMODE_BLEND);
-    SDL_UpdateTexture(texture_, nullptr, pixels_, width_ * sizeof(std::uint32_t));
+    SDL_UpdateTexture(texture_, nullptr, buffer_, width_ * sizeof(std::uint32_t));
 }
 
 Bitmap::~Bitmap()
 {
-    SDL_DestroyTexture(texture_);
-    texture_ = nullptr;
+    if (texture_ != nullptr)
+    {
+        SDL_DestroyTexture(texture_);
+        texture_ = nullptr;
+    }
 
-    delete[] pixels_;
+    FreePixels(buffer_);
+    buffer_ = nullptr;
     pixels_ = nullptr;
+
+    FreePixels(columns_);
+    columns_ = nullptr;
 }
 
 void Bitmap::DrawBitmap(const Bitmap& bitmap, int x_offset, int y_offset)
 {
-    for (int y = 0; y < static_cast<int>(bitmap.height_); ++y)
+    // Clipped once against the view, after which every row is one straight copy.
+    const int begin_x = std::max(0, -x_offset);
+    const int end_x = std::min(bitmap.view_width_, view_width_ - x_offset);
+    const int begin_y = std::max(0, -y_offset);
+    const int end_y = std::min(bitmap.view_height_, view_height_ - y_offset);
+
+    if (begin_x >= end_x)
     {
-        const int dest_y = y + y_offset;
+        return;
+    }
 
-        if (dest_y < 0 || dest_y > static_cast<int>(height_))
-        {
-            continue;
-        }
+    for (int y = begin_y; y < end_y; ++y)
+    {
+        std::memcpy(pixels_ + (y + y_offset) * pitch_ + x_offset + begin_x, bitmap.pixels_ + y * bitmap.pitch_ + begin_x, (end_x - begin_x) * sizeof(std::uint32_t));
+    }
+}
 
-        for (int x = 0; x < static_cast<int>(bitmap.width_); ++x)
-        {
-            const int dest_x = x + x_offset;
+void Bitmap::DrawFillRect(int top_left_x, int top_left_y, int bottom_right_x, int bottom_right_y, std::uint32_t color)
+{
+    const int begin_x = std::max(top_left_x, 0);
+    const int end_x = std::min(bottom_right_x, view_width_);
+    const int begin_y = std::max(top_left_y, 0);
+    const int end_y = std::min(bottom_right_y, view_height_);
 
-            if (dest_x < 0 || dest_x > static_cast<int>(width_))
-            {
-                continue;
-            }
+    if (begin_x >= end_x)
+    {
+        return;
+    }
 
-            pixels_[dest_y * width_ + dest_x] = bitmap.pixels_[y * bitmap.width_ + x];
-        }   
+    for (int y = begin_y; y < end_y; ++y)
+    {
+        FillRow(pixels_ + y * pitch_ + begin_x, end_x - begin_x, color);
     }
 }
 
-void Bitmap::DrawFillRect(int top_left_x, int top_left_y, int bottom_right_x, int bottom_right_y, std::uint32_t color)
+void Bitmap::DrawPoint(int x, int y, std::uint32_t color)
+{
+    if (x < 0 || x >= view_width_ || y < 0 || y >= view_height_)
+    {
+        return;
+    }
+
+    pixels_[y * pitch_ + x] = color;
+}
+
+void Bitmap::DrawLine(int x1, int y1, int x2, int y2, std::uint32_t color)
 {
-    if (top_left_x > bottom_right_x || top_left_y > bottom_right_y)
+    if (!ClipLine(x1, y1, x2, y2))
     {
         return;
     }
 
-    for (int y = top_left_y; y < bottom_right_y; ++y)
+    // Bresenham: both ends are inside the view now, and so is every pixel between them.
+    const int dx = std::abs(x2 - x1);
+    const int dy = -std::abs(y2 - y1);
+    const std::ptrdiff_t step_x = x1 < x2 ? 1 : -1;
+    const std::ptrdiff_t step_y = y1 < y2 ? static_cast<std::ptrdiff_t>(pitch_) : -static_cast<std::ptrdiff_t>(pitch_);
+    std::uint32_t* pixel = pixels_ + y1 * pitch_ + x1;
+    int error = dx + dy;
+
+    for (int i = std::max(dx, -dy); i >= 0; --i)
     {
-        if (y < 0 || y > static_cast<int>(height_))
+        *pixel = color;
+        const int error2 = 2 * error;
+
+        if (error2 >= dy)
         {
-            continue;
+            error += dy;
+            pixel += step_x;
         }
 
-        for (int x = top_left_x; x < bottom_right_x; ++x)
+        if (error2 <= dx)
         {
-            if (x < 0 || x > static_cast<int>(width_))
-            {
-                continue;
-            }
-
-            pixels_[y * width_ + x] = color;
+            error += dx;
+            pixel += step_y;
         }
     }
 }
 
-void Bitmap::DrawPoint(int x, int y, std::uint32_t color)
+bool Bitmap::ClipLine(int& x1, int& y1, int& x2, int& y2)
 {
-    if (x < 0 || x > static_cast<int>(width_) || y < 0 || y > static_cast<int>(height_))
+    // Cohen-Sutherland against the view, in floating point so that the cut ends are rounded only once.
+    const double max_x = view_width_ - 1;
+    const double max_y = view_height_ - 1;
+    double line_x1 = x1;
+    double line_y1 = y1;
+    double line_x2 = x2;
+    double line_y2 = y2;
+
+    const auto get_outcode = [max_x, max_y](double x, double y)
     {
-        return;
+        return (x < 0.0 ? outcode_left : 0) | (x > max_x ? outcode_right : 0) | (y < 0.0 ? outcode_top : 0) | (y > max_y ? outcode_bottom : 0);
+    };
+
+    int outcode1 = get_outcode(line_x1, line_y1);
+    int outcode2 = get_outcode(line_x2, line_y2);
+
+    while ((outcode1 | outcode2) != 0)
+    {
+        // Both ends beyond the same edge.
+        if ((outcode1 & outcode2) != 0)
+        {
+            return false;
+        }
+
+        const int outcode = outcode1 != 0 ? outcode1 : outcode2;
+        double x = 0.0;
+        double y = 0.0;
+
+        if (outcode & outcode_top)
+        {
+            x = line_x1 + (line_x2 - line_x1) * (0.0 - line_y1) / (line_y2 - line_y1);
+            y = 0.0;
+        }
+        else if (outcode & outcode_bottom)
+        {
+            x = line_x1 + (line_x2 - line_x1) * (max_y - line_y1) / (line_y2 - line_y1);
+            y = max_y;
+        }
+        else if (outcode & outcode_left)
+        {
+            y = line_y1 + (line_y2 - line_y1) * (0.0 - line_x1) / (line_x2 - line_x1);
+            x = 0.0;
+        }
+        else
+        {
+            y = line_y1 + (line_y2 - line_y1) * (max_x - line_x1) / (line_x2 - line_x1);
+            x = max_x;
+        }
+
+        if (outcode == outcode1)
+        {
+            line_x1 = x;
+            line_y1 = y;
+            outcode1 = get_outcode(line_x1, line_y1);
+        }
+        else
+        {
+            line_x2 = x;
+            line_y2 = y;
+            outcode2 = get_outcode(line_x2, line_y2);
+        }
     }
 
-    pixels_[y * width_ + x] = color;
+    x1 = static_cast<int>(std::lround(line_x1));
+    y1 = static_cast<int>(std::lround(line_y1));
+    x2 = static_cast<int>(std::lround(line_x2));
+    y2 = static_cast<int>(std::lround(line_y2));
+
+    return true;
 }
 
-void Bitmap::DrawLine(int x1, int y1, int x2, int y2, std::uint32_t color)
+void Bitmap::BeginFrame()
 {
-    bool y_longer = false;
-    int increment_val = 0;
-    int end_val = 0;
-	int short_len = y2 - y1;
-	int long_len = x2 - x1;
-	
-    if (std::abs(short_len) > std::abs(long_len))
-    {
-		int swap = short_len;
-		short_len = long_len;
-		long_len = swap;
-		y_longer = true;
-	}
-	
-	end_val = long_len;
-	
-    if (long_len < 0)
+    frame_drawn_ = true;
+
+    if (locked_ || !lock_supported_)
     {
-		increment_val = -1;
-		long_len = -long_len;
-	} 
-    else
-    { 
-        increment_val = 1;
+        return;
     }
 
-	double dec_inc = 0.0;
+    // Only the view is locked, so unlocking uploads just the part that dynamic resolution renders.
+    const SDL_Rect view = { 0, 0, view_width_, view_height_ };
+    void* texture_pixels = nullptr;
+    int texture_pitch = 0;
 
-	if (long_len == 0)
+    if (SDL_LockTexture(texture_, &view, &texture_pixels, &texture_pitch) != 0)
     {
-        dec_inc = static_cast<double>(short_len);
-    } 
-	else
-    { 
-        dec_inc = (static_cast<double>(short_len) / static_cast<double>(long_len));
+        printf("Streaming texture can't be locked, frames are uploaded instead! SDL Error: %s\n", SDL_GetError());
+        lock_supported_ = false;
+        return;
     }
-	
-    double j = 0.0;
-	
-    if (y_longer)
-    {
-		for (int i = 0; i != end_val; i += increment_val)
-        {
-            pixels_[(y1 + i) * width_ + (x1 + static_cast<int>(j))] = color;
-			j += dec_inc;
-		}
-	} 
-    else 
-    {
-		for (int i = 0; i != end_val; i += increment_val)
-        {
-            pixels_[(y1 + static_cast<int>(j)) * width_ + (x1 + i)] = color;
-			j += dec_inc;
-		}
-	}
+
+    pixels_ = static_cast<std::uint32_t*>(texture_pixels);
+    pitch_ = texture_pitch / sizeof(std::uint32_t);
+    locked_ = true;
 }
 
 void Bitmap::Render()
 {
-    SDL_UpdateTexture(texture_, nullptr, pixels_, width_ * sizeof(std::uint32_t));
-    SDL_RenderCopy(renderer_, texture_, nullptr, nullptr);
+    const SDL_Rect view = { 0, 0, view_width_, view_height_ };
+
+    if (locked_)
+    {
+        SDL_UnlockTexture(texture_);
+        locked_ = false;
+
+        // Nothing may draw into the texture memory once it is unlocked.
+        pixels_ = buffer_;
+        pitch_ = width_;
+    }
+    else if (frame_drawn_)
+    {
+        // Only the rendered part is uploaded; the copy scales it up to the window with nearest filtering.
+        SDL_UpdateTexture(texture_, &view, buffer_, width_ * sizeof(std::uint32_t));
+    }
+
+    // A frame the temporal cache reused is still in the texture from the last Render().
+    frame_drawn_ = false;
+    SDL_RenderCopy(renderer_, texture_, &view, nullptr);
 }
 
 void Bitmap::Clear()
+{
+    const std::uint32_t color = GetClearColor();
+
+    if (column_major_)
+    {
+        std::fill(columns_, columns_ + view_width_ * view_height_, color);
+        return;
+    }
+
+    for (int y = 0; y < view_height_; ++y)
+    {
+        FillRow(pixels_ + y * pitch_, view_width_, color);
+    }
+}
+
+std::uint32_t Bitmap::GetClearColor()
 {
     SDL_Color background_color;
     background_color.r = 0;
@@ -172,8 +443,96 @@ void Bitmap::Clear()
     std::uint32_t color = (255 << 24) + (background_color.r << 16) + (background_color.g << 8) + background_color.b;
     #endif
 
-    for (std::size_t i = 0; i < width_ * height_; ++i)
+    return color;
+}
+
+void Bitmap::SetColumnMajor(bool column_major)
+{
+    if (column_major && columns_ == nullptr)
+    {
+        columns_ = AllocatePixels(width_ * height_);
+    }
+
+    column_major_ = column_major;
+}
+
+bool Bitmap::IsColumnMajor()
+{
+    return column_major_;
+}
+
+std::uint32_t* Bitmap::GetColumn(int x, std::ptrdiff_t& stride)
+{
+    if (column_major_)
+    {
+        stride = 1;
+        return columns_ + x * view_height_;
+    }
+
+    stride = pitch_;
+    return pixels_ + x;
+}
+
+void Bitmap::TransposeColumns(int begin_x, int end_x)
+{
+    const int height = view_height_;
+    alignas(32) std::uint32_t strip[transpose_block * transpose_strip_width];
+
+    // Each block-row of the band is transposed into a small strip first so that every output row is then
+    // written as one contiguous run; streaming those runs skips reading the destination lines back in.
+    for (int strip_x = begin_x; strip_x < end_x; strip_x += transpose_strip_width)
     {
-        pixels_[i] = color;
+        const int strip_width = std::min(transpose_strip_width, end_x - strip_x);
+        const int block_width = strip_width / transpose_block * transpose_block;
+        int y = 0;
+
+        for (; y + transpose_block <= height; y += transpose_block)
+        {
+            for (int x = 0; x < block_width; x += transpose_block)
+            {
+                TransposeBlock(columns_ + (strip_x + x) * height + y, height, strip + x, transpose_strip_width);
+            }
+
+            for (int x = block_width; x < strip_width; ++x)
+            {
+                for (int i = 0; i < transpose_block; ++i)
+                {
+                    strip[i * transpose_strip_width + x] = columns_[(strip_x + x) * height + y + i];
+                }
+            }
+
+            for (int i = 0; i < transpose_block; ++i)
+            {
+                StreamRow(strip + i * transpose_strip_width, pixels_ + (y + i) * pitch_ + strip_x, strip_width);
+            }
+        }
+
+        for (; y < height; ++y)
+        {
+            for (int x = 0; x < strip_width; ++x)
+            {
+                pixels_[y * pitch_ + strip_x + x] = columns_[(strip_x + x) * height + y];
+            }
+        }
     }
+
+#if defined(__SSE2__)
+    _mm_sfence();
+#endif
+}
+
+void Bitmap::SetViewport(int view_width, int view_height)
+{
+    view_width_ = std::clamp(view_width, 1, static_cast<int>(width_));
+    view_height_ = std::clamp(view_height, 1, static_cast<int>(height_));
+}
+
+int Bitmap::GetViewWidth()
+{
+    return view_width_;
+}
+
+int Bitmap::GetViewHeight()
+{
+    return view_height_;
 }
@@ -0,0 +1,63 @@
+#include "Camera.hpp"
+
+#include <cmath>
+
+Camera::Camera(int max_view_width) : 
+	camera_x_(max_view_width, 0.0), 
+	ray_dirs_(max_view_width), 
+	ray_lengths_(max_view_width, 0.0), 
+	view_width_(0), 
+	direction_(0.0f, 0.0f), 
+	plane_(0.0f, 0.0f), 
+	direction_length_(0.0), 
+	rotation_degrees_(0), 
+	rotation_cos_(1.0), 
+	rotation_sin_(0.0)
+{
+}
+
+void Camera::Update(int view_width, const Vect2d<float>& direction, const Vect2d<float>& plane)
+{
+	const bool resized = view_width != view_width_;
+
+	if (resized)
+	{
+		view_width_ = view_width;
+
+		for (int x = 0; x < view_width_; ++x)
+		{
+			camera_x_[x] = ((2 * x) / static_cast<double>(view_width_)) - 1;
+		}
+	}
+
+	if (!resized && direction.x_ == direction_.x_ && direction.y_ == direction_.y_ && plane.x_ == plane_.x_ && plane.y_ == plane_.y_)
+	{
+		return;
+	}
+
+	direction_ = direction;
+	plane_ = plane;
+	direction_length_ = direction_.GetLength();
+
+	for (int x = 0; x < view_width_; ++x)
+	{
+		ray_dirs_[x] = { direction_.x_ + plane_.x_ * camera_x_[x], direction_.y_ + plane_.y_ * camera_x_[x] };
+		ray_lengths_[x] = ray_dirs_[x].GetLength();
+	}
+}
+
+void Camera::GetRotation(int degrees, double& cos_degrees, double& sin_degrees)
+{
+	if (degrees != rotation_degrees_)
+	{
+		const double pi = std::acos(-1);
+		const double deg_to_rad = static_cast<double>(degrees) * pi / 180.0;
+
+		rotation_degrees_ = degrees;
+		rotation_cos_ = std::cos(deg_to_rad);
+		rotation_sin_ = std::sin(deg_to_rad);
+	}
+
+	cos_degrees = rotation_cos_;
+	sin_degrees = rotation_sin_;
+}
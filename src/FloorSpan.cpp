@@ -0,0 +1,136 @@
+#include "FloorSpan.hpp"
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	template <bool PowerOfTwoSize>
+	int WrapTexel(int texel, int size)
+	{
+		if constexpr (PowerOfTwoSize)
+		{
+			return texel & (size - 1);
+		}
+		else
+		{
+			// Floor coordinates behind the origin are negative, and so is their remainder.
+			const int remainder = texel % size;
+			return remainder < 0 ? remainder + size : remainder;
+		}
+	}
+
+	template <bool PowerOfTwoSize>
+	void DrawFloorSpan(const FloorSpan& span, int y, const int* wall_tops, const int* wall_bottoms, std::uint32_t* row, int begin_x, int end_x)
+	{
+		int x = begin_x;
+
+#if defined(__AVX2__)
+		// Vector remainders would cost more than the gathers, so other sizes take the scalar loop.
+		if constexpr (PowerOfTwoSize)
+		{
+			const __m256 lane_offsets = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+			const __m256 u = _mm256_set1_ps(span.u_);
+			const __m256 v = _mm256_set1_ps(span.v_);
+			const __m256 du = _mm256_set1_ps(span.du_);
+			const __m256 dv = _mm256_set1_ps(span.dv_);
+			const __m256i u_masks = _mm256_set1_epi32(span.texture_width_ - 1);
+			const __m256i v_masks = _mm256_set1_epi32(span.texture_height_ - 1);
+			const __m256i texture_height = _mm256_set1_epi32(span.texture_height_);
+			const __m256i ys = _mm256_set1_epi32(y);
+			const __m256i all_ones = _mm256_set1_epi32(-1);
+
+			for (; x + 8 <= end_x; x += 8)
+			{
+				const __m256i tops = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(wall_tops + x));
+				const __m256i bottoms = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(wall_bottoms + x));
+				const __m256i above = _mm256_cmpgt_epi32(tops, ys);
+				const __m256i below = _mm256_andnot_si256(_mm256_cmpgt_epi32(bottoms, ys), all_ones);
+				const __m256i visible = _mm256_or_si256(above, below);
+
+				// Rows through the middle of the screen are mostly wall, so whole groups are skipped before any gather.
+				if (_mm256_testz_si256(visible, visible))
+				{
+					continue;
+				}
+
+				const __m256 xs = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), lane_offsets);
+				const __m256i tex_x = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(u, _mm256_mul_ps(du, xs)))), u_masks);
+				const __m256i tex_y = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(v, _mm256_mul_ps(dv, xs)))), v_masks);
+				const __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(tex_x, texture_height), tex_y);
+				const __m256i texels = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(span.texels_), index, visible, 4);
+
+				_mm256_maskstore_epi32(reinterpret_cast<int*>(row + x), visible, texels);
+			}
+		}
+#endif
+
+		for (; x < end_x; ++x)
+		{
+			if (y >= wall_tops[x] && y < wall_bottoms[x])
+			{
+				continue;
+			}
+
+			const int tex_x = WrapTexel<PowerOfTwoSize>(static_cast<int>(std::floor(span.u_ + span.du_ * x)), span.texture_width_);
+			const int tex_y = WrapTexel<PowerOfTwoSize>(static_cast<int>(std::floor(span.v_ + span.dv_ * x)), span.texture_height_);
+
+			row[x] = span.texels_[tex_x * span.texture_height_ + tex_y];
+		}
+	}
+} // namespace
+
+FloorSpanKernel GetFloorSpanKernel(bool power_of_two_size)
+{
+	return power_of_two_size ? &DrawFloorSpan<true> : &DrawFloorSpan<false>;
+}
+
+int ClearFloorSpan(std::uint32_t color, int y, const int* wall_tops, const int* wall_bottoms, std::uint32_t* row, int begin_x, int end_x)
+{
+	int filled = 0;
+	int x = begin_x;
+
+#if defined(__AVX2__)
+	const __m256i colors = _mm256_set1_epi32(static_cast<int>(color));
+	const __m256i ys = _mm256_set1_epi32(y);
+	const __m256i all_ones = _mm256_set1_epi32(-1);
+
+	for (; x + 8 <= end_x; x += 8)
+	{
+		const __m256i tops = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(wall_tops + x));
+		const __m256i bottoms = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(wall_bottoms + x));
+		const __m256i above = _mm256_cmpgt_epi32(tops, ys);
+		const __m256i below = _mm256_andnot_si256(_mm256_cmpgt_epi32(bottoms, ys), all_ones);
+		const __m256i visible = _mm256_or_si256(above, below);
+		const int lanes = _mm256_movemask_ps(_mm256_castsi256_ps(visible));
+
+		// Rows near the top and bottom are uncovered all the way, the ones through the middle mostly wall.
+		if (lanes == 0xff)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(row + x), colors);
+			filled += 8;
+		}
+		else if (lanes != 0)
+		{
+			_mm256_maskstore_epi32(reinterpret_cast<int*>(row + x), visible, colors);
+			filled += __builtin_popcount(lanes);
+		}
+	}
+#endif
+
+	for (; x < end_x; ++x)
+	{
+		if (y >= wall_tops[x] && y < wall_bottoms[x])
+		{
+			continue;
+		}
+
+		row[x] = color;
+		++filled;
+	}
+
+	return filled;
+}
@@ -1,5 +1,7 @@
 #include "Game.hpp"
 #include "Constants.hpp"
+#include "Minimap.hpp"
+#include "PerfCounter.hpp"
 #include "Player.hpp"
 #include "Level.hpp"
 #include "Texture.hpp"
@@ -8,22 +10,45 @@
 #include <SDL2/SDL_image.h>
 
 #include <cstdint>
+#include <cstdlib>
+#include <functional>
 #include <iostream>
 #include <memory>
 
-Game::Game() : 
+Game::Game(const Options& options) : 
 	initialized_(false), 
+	level_loaded_(false), 
 	running_(false), 
+	benchmark_ticks_(options.benchmark_ticks_), 
+	maze_col_count_(options.maze_col_count_), 
+	maze_row_count_(options.maze_row_count_), 
+	maze_seed_(options.maze_seed_), 
+	maze_chunk_size_(options.maze_chunk_size_), 
+	convert_path_(options.convert_path_), 
+	chunk_memory_budget_(options.chunk_memory_budget_), 
 	map_toggled_(true), 
 	fisheye_effect_toggled_(false), 
-	textures_toggled_(false)
+	textures_toggled_(false), 
+	parallel_toggled_(true), 
+	packets_toggled_(false), 
+	skipping_toggled_(false), 
+	hierarchical_toggled_(false), 
+	mipmaps_toggled_(false), 
+	fog_toggled_(false), 
+	floor_toggled_(false), 
+	dynamic_resolution_toggled_(false), 
+	adaptive_toggled_(false), 
+	temporal_cache_toggled_(false), 
+	full_clear_toggled_(false), 
+	stats_toggled_(false), 
+	resolution_controller_(options.target_frame_ms_), 
+	window_(nullptr), 
+	renderer_(nullptr)
 {
-	initialized_ = InitializeSDL();
+	// Converting needs neither a window nor wall textures, so it also runs where there is no display.
+	initialized_ = convert_path_ != nullptr ? InitializeConverter() : InitializeSDL();
 
-	screen_ = std::make_unique<Screen>(this);
-	level_ = std::make_unique<Level>(this, screen_.get());
-	level_->Initialize("res/gfx/level.png");
-	player_ = std::make_unique<Player>(this, screen_.get(), level_.get());
+	thread_pool_ = std::make_unique<ThreadPool>(options.thread_count_);
 
 	constexpr std::size_t textures_count = 6;
 
@@ -32,12 +57,27 @@ Game::Game() :
 		textures_.emplace_back(std::make_unique<Texture>(this));
 	}
 
-	textures_[0]->LoadPixelsFromFile("res/gfx/red.png");
-	textures_[1]->LoadPixelsFromFile("res/gfx/green.png");
-	textures_[2]->LoadPixelsFromFile("res/gfx/blue.png");
-	textures_[3]->LoadPixelsFromFile("res/gfx/yellow.png");
-	textures_[4]->LoadPixelsFromFile("res/gfx/ceiling.png");
-	textures_[5]->LoadPixelsFromFile("res/gfx/floor.png");
+	if (convert_path_ == nullptr)
+	{
+		textures_[0]->LoadPixelsFromFile("res/gfx/red.png");
+		textures_[1]->LoadPixelsFromFile("res/gfx/green.png");
+		textures_[2]->LoadPixelsFromFile("res/gfx/blue.png");
+		textures_[3]->LoadPixelsFromFile("res/gfx/yellow.png");
+		textures_[4]->LoadPixelsFromFile("res/gfx/ceiling.png");
+		textures_[5]->LoadPixelsFromFile("res/gfx/floor.png");
+	}
+
+	// The level resolves its wall textures while building the material table, so they are loaded first.
+	screen_ = std::make_unique<Screen>(this);
+	level_ = std::make_unique<Level>(this, screen_.get());
+	level_loaded_ = level_->Initialize(options.level_path_);
+	player_ = std::make_unique<Player>(this, screen_.get(), level_.get());
+
+	if (options.generate_maze_)
+	{
+		GenerateMaze();
+		level_loaded_ = true;
+	}
 }
 
 Game::~Game()
@@ -87,6 +127,26 @@ bool Game::InitializeSDL()
 	return true;
 }
 
+bool Game::InitializeConverter()
+{
+	// No subsystems; SDL_image decodes level images without video.
+	if (SDL_Init(0) < 0)
+	{
+		printf("SDL could not be initialized! SDL Error: %s\n", SDL_GetError());
+		return false;
+	}
+
+	constexpr int img_flags = IMG_INIT_PNG;
+
+	if (!(IMG_Init(img_flags) & img_flags))
+	{
+		printf("SDL_image could not be initialized! SDL_image Error: %s\n", IMG_GetError());
+		return false;
+	}
+
+	return true;
+}
+
 void Game::Finalize()
 {
 	SDL_DestroyWindow(window_);
@@ -99,11 +159,36 @@ void Game::Finalize()
 	IMG_Quit();
 }
 
-void Game::Run()
+int Game::Run()
 {
 	if (!initialized_)
 	{
-		return;
+		return EXIT_FAILURE;
+	}
+
+	// Every mode reads the level, so without one there is nothing to play, time or write.
+	if (!level_loaded_)
+	{
+		printf("%s\n", "No level was loaded!");
+		return EXIT_FAILURE;
+	}
+
+	if (convert_path_ != nullptr)
+	{
+		if (!level_->Save(convert_path_))
+		{
+			printf("Nothing was written to %s!\n", convert_path_);
+			return EXIT_FAILURE;
+		}
+
+		printf("Wrote %dx%d level to %s\n", level_->GetColumnCount(), level_->GetRowCount(), convert_path_);
+		return EXIT_SUCCESS;
+	}
+
+	if (benchmark_ticks_ > 0)
+	{
+		RunBenchmark();
+		return EXIT_SUCCESS;
 	}
 
 	running_ = true;
@@ -116,6 +201,7 @@ void Game::Run()
 
 	int frames = 0;
 	int ticks = 0;
+	std::uint64_t ticks_time = 0;
 
 	while (running_)
 	{
@@ -127,25 +213,137 @@ void Game::Run()
 
 		HandleEvents();
 
+		std::uint64_t frame_time = 0;
+		bool ticked = false;
+
 		while (delta >= ms)
 		{
+			const std::uint64_t tick_start = SDL_GetPerformanceCounter();
 			Tick();
+			const std::uint64_t tick_time = SDL_GetPerformanceCounter() - tick_start;
+			ticks_time += tick_time;
+			frame_time += tick_time;
+			ticked = true;
 			delta -= ms;
 			++ticks;
 		}
 
 		//printf("%Lf\n", delta / ms);
+		const std::uint64_t render_start = SDL_GetPerformanceCounter();
 		Render();
+		frame_time += SDL_GetPerformanceCounter() - render_start;
 		++frames;
 
+		if (dynamic_resolution_toggled_ && ticked)
+		{
+			// The new view size takes effect from the next tick, so a frame never mixes two resolutions.
+			resolution_controller_.Update(1000.0 * frame_time / static_cast<double>(SDL_GetPerformanceFrequency()));
+			screen_->bitmap_->SetViewport(resolution_controller_.Scale(constants::screen_width), resolution_controller_.Scale(constants::screen_height));
+		}
+
 		if (SDL_GetTicks() - timer > 1000.0)
 		{
 			timer += 1000.0;
-			//printf("Frames: %d, Ticks: %d\n", frames, ticks);
+
+			if (stats_toggled_)
+			{
+				const double tick_ms = ticks == 0 ? 0.0 : 1000.0 * ticks_time / static_cast<double>(SDL_GetPerformanceFrequency()) / ticks;
+				const RayScratch ray_stats = player_->CollectRayStats();
+				const double steps_per_ray = ray_stats.rays_cast_ == 0 ? 0.0 : ray_stats.dda_steps_ / static_cast<double>(ray_stats.rays_cast_);
+				const double rays_per_column = ray_stats.columns_drawn_ == 0 ? 0.0 : ray_stats.rays_cast_ / static_cast<double>(ray_stats.columns_drawn_);
+				const double columns_per_strip = ray_stats.strips_drawn_ == 0 ? 0.0 : ray_stats.columns_drawn_ / static_cast<double>(ray_stats.strips_drawn_);
+				const double cleared_kb = ticks == 0 ? 0.0 : ray_stats.pixels_cleared_ * sizeof(std::uint32_t) / 1024.0 / ticks;
+				printf("Frames: %d, Ticks: %d, Tick: %.3f ms, Threads: %zu (%s), Tracer: %s, Skipping: %s, Pyramid: %s, Layout: %s, Steps/ray: %.2f, Rays cast: %.1f%%, Columns/strip: %.1f, Cleared/tick: %.0f KB (%s), View: %dx%d", frames, ticks, tick_ms, thread_pool_->GetThreadCount(), parallel_toggled_ ? "parallel" : "serial", packets_toggled_ ? "packet" : "scalar", skipping_toggled_ ? "on" : "off", hierarchical_toggled_ ? "on" : "off", screen_->bitmap_->IsColumnMajor() ? "column-major" : "row-major", steps_per_ray, 100.0 * rays_per_column, columns_per_strip, cleared_kb, full_clear_toggled_ ? "full" : "uncovered", screen_->bitmap_->GetViewWidth(), screen_->bitmap_->GetViewHeight());
+
+				if (temporal_cache_toggled_)
+				{
+					const double rays_seeded = ray_stats.columns_drawn_ == 0 ? 0.0 : ray_stats.rays_seeded_ / static_cast<double>(ray_stats.columns_drawn_);
+					printf(", Frames reused: %llu, Rays seeded: %.1f%%", static_cast<unsigned long long>(ray_stats.frames_reused_), 100.0 * rays_seeded);
+				}
+
+				if (level_->IsStreamed())
+				{
+					printf(", Chunks: %zu resident, %llu loaded", level_->GetChunkStore()->GetResidentCount(), static_cast<unsigned long long>(level_->GetChunkStore()->GetLoadCount()));
+				}
+
+				if (dynamic_resolution_toggled_)
+				{
+					printf(" (scale %.3f, frame %.3f ms, target %.3f ms)", resolution_controller_.GetScale(), resolution_controller_.GetAverageFrameMs(), resolution_controller_.GetTargetFrameMs());
+				}
+
+				printf("\n");
+			}
+
 			frames = 0;
 			ticks = 0;
+			ticks_time = 0;
 		}
 	}
+
+	return EXIT_SUCCESS;
+}
+
+void Game::RunBenchmark()
+{
+	struct Scenario
+	{
+		const char* name_;
+		std::function<void()> setup_;
+	};
+
+	const Scenario scenarios[] = 
+	{
+		{ "textured", [this]() { textures_toggled_ = true; mipmaps_toggled_ = false; } }, 
+		{ "textured, mipmaps", [this]() { textures_toggled_ = true; mipmaps_toggled_ = true; } }, 
+		{ "textured, mipmaps, floor", [this]() { textures_toggled_ = true; mipmaps_toggled_ = true; floor_toggled_ = true; } }
+	};
+
+	constexpr int warmup_ticks = 10;
+	CacheMissCounter cache_misses;
+
+	// The minimap would dominate small views and is not what the scenarios compare.
+	map_toggled_ = false;
+
+	for (const Scenario& scenario : scenarios)
+	{
+		scenario.setup_();
+
+		for (int i = 0; i < warmup_ticks; ++i)
+		{
+			Tick();
+		}
+
+		cache_misses.Start();
+		const std::uint64_t start = SDL_GetPerformanceCounter();
+
+		for (int i = 0; i < benchmark_ticks_; ++i)
+		{
+			Tick();
+			Render();
+		}
+
+		const std::uint64_t elapsed = SDL_GetPerformanceCounter() - start;
+		const std::uint64_t misses = cache_misses.Stop();
+		const double frame_ms = 1000.0 * elapsed / static_cast<double>(SDL_GetPerformanceFrequency()) / benchmark_ticks_;
+
+		if (cache_misses.IsAvailable())
+		{
+			printf("Benchmark: %s, Frame: %.3f ms, Cache misses/frame: %.0f\n", scenario.name_, frame_ms, misses / static_cast<double>(benchmark_ticks_));
+		}
+		else
+		{
+			printf("Benchmark: %s, Frame: %.3f ms, Cache misses/frame: n/a\n", scenario.name_, frame_ms);
+		}
+	}
+
+	// The last scenario's view, traced with both DDA backends on one thread.
+	player_->CompareDdaBackends(benchmark_ticks_);
+
+	// Last, since it replaces the level.
+	const std::uint64_t maze_start = SDL_GetPerformanceCounter();
+	GenerateMaze();
+	const double maze_ms = 1000.0 * (SDL_GetPerformanceCounter() - maze_start) / static_cast<double>(SDL_GetPerformanceFrequency());
+	printf("Benchmark: %dx%d maze, Chunk: %d, Generation: %.3f ms\n", level_->GetColumnCount(), level_->GetRowCount(), maze_chunk_size_, maze_ms);
 }
 
 void Game::HandleEvents()
@@ -175,7 +373,75 @@ void Game::HandleEvents()
 			}
 			else if (e.key.keysym.sym == SDLK_g)
 			{
-				level_->GenerateMazeHuntAndKill();
+				GenerateMaze();
+			}
+			else if (e.key.keysym.sym == SDLK_p)
+			{
+				parallel_toggled_ = !parallel_toggled_;
+			}
+			else if (e.key.keysym.sym == SDLK_v)
+			{
+				packets_toggled_ = !packets_toggled_;
+			}
+			else if (e.key.keysym.sym == SDLK_k)
+			{
+				skipping_toggled_ = !skipping_toggled_;
+			}
+			else if (e.key.keysym.sym == SDLK_h)
+			{
+				hierarchical_toggled_ = !hierarchical_toggled_;
+			}
+			else if (e.key.keysym.sym == SDLK_n)
+			{
+				mipmaps_toggled_ = !mipmaps_toggled_;
+			}
+			else if (e.key.keysym.sym == SDLK_l)
+			{
+				fog_toggled_ = !fog_toggled_;
+			}
+			else if (e.key.keysym.sym == SDLK_e)
+			{
+				floor_toggled_ = !floor_toggled_;
+			}
+			else if (e.key.keysym.sym == SDLK_d)
+			{
+				dynamic_resolution_toggled_ = !dynamic_resolution_toggled_;
+				resolution_controller_.Reset();
+				screen_->bitmap_->SetViewport(constants::screen_width, constants::screen_height);
+			}
+			else if (e.key.keysym.sym == SDLK_a)
+			{
+				adaptive_toggled_ = !adaptive_toggled_;
+			}
+			else if (e.key.keysym.sym == SDLK_j)
+			{
+				temporal_cache_toggled_ = !temporal_cache_toggled_;
+			}
+			else if (e.key.keysym.sym == SDLK_EQUALS)
+			{
+				level_->GetMinimap().ZoomIn();
+			}
+			else if (e.key.keysym.sym == SDLK_MINUS)
+			{
+				level_->GetMinimap().ZoomOut();
+			}
+			else if (e.key.keysym.sym == SDLK_b)
+			{
+				full_clear_toggled_ = !full_clear_toggled_;
+			}
+			else if (e.key.keysym.sym == SDLK_o)
+			{
+				screen_->bitmap_->SetColumnMajor(!screen_->bitmap_->IsColumnMajor());
+			}
+			else if (e.key.keysym.sym == SDLK_c)
+			{
+				player_->ComparePacketTracer();
+				player_->CompareDdaBackends(1);
+			}
+			else if (e.key.keysym.sym == SDLK_i)
+			{
+				stats_toggled_ = !stats_toggled_;
+				player_->CollectRayStats();
 			}
 		}
 
@@ -185,7 +451,12 @@ void Game::HandleEvents()
 
 void Game::Tick()
 {
-	screen_->bitmap_->Clear();
+	// A reused frame is still in the texture and is not drawn at all.
+	if (!player_->PrepareFrame())
+	{
+		screen_->bitmap_->BeginFrame();
+	}
+
 	player_->Tick();
 }
 
@@ -200,6 +471,18 @@ void Game::Render()
 	SDL_RenderPresent(renderer_);
 }
 
+void Game::GenerateMaze()
+{
+	if (maze_chunk_size_ > 0)
+	{
+		level_->GenerateMazeChunked(maze_col_count_, maze_row_count_, maze_seed_++, maze_chunk_size_);
+	}
+	else
+	{
+		level_->GenerateMazeHuntAndKill(maze_col_count_, maze_row_count_, maze_seed_++);
+	}
+}
+
 std::uint32_t Game::GetColor(const SDL_Color& color)
 {
 	#if SDL_BYTEORDER == SDL_BIG_ENDIAN
@@ -216,3 +499,30 @@ bool Game::ColorsEqual(const SDL_Color& color1, const SDL_Color& color2)
 	return color1.r == color2.r && color1.g == color2.g && color1.b == color2.b && color1.a == color2.a;
 }
 
+Texture* Game::GetWallTexture(const SDL_Color& color)
+{
+	const SDL_Color red = { 0xff, 0x00, 0x00, 0xff };
+	const SDL_Color green = { 0x00, 0xff, 0x00, 0xff };
+	const SDL_Color blue = { 0x00, 0x00, 0xff, 0xff };
+	const SDL_Color yellow = { 0xff, 0xff, 0x00, 0xff };
+
+	if (ColorsEqual(color, red))
+	{
+		return textures_[0].get();
+	}
+	else if (ColorsEqual(color, green))
+	{
+		return textures_[1].get();
+	}
+	else if (ColorsEqual(color, blue))
+	{
+		return textures_[2].get();
+	}
+	else if (ColorsEqual(color, yellow))
+	{
+		return textures_[3].get();
+	}
+
+	return nullptr;
+}
+
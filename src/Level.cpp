@@ -1,24 +1,153 @@
 #include "Game.hpp"
 #include "Level.hpp"
 #include "Constants.hpp"
+#include "LevelFile.hpp"
+#include "Minimap.hpp"
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+
+namespace
+{
+	bool HasExtension(const char* path, const char* extension)
+	{
+		const std::size_t path_length = std::strlen(path);
+		const std::size_t extension_length = std::strlen(extension);
+
+		return path_length >= extension_length && std::strcmp(path + path_length - extension_length, extension) == 0;
+	}
+
+	bool GetBit(const std::uint32_t* bits, int index)
+	{
+		return (bits[index >> 5] >> (index & 31)) & 1;
+	}
+
+	// The ray tracers read a mapped level without bounds checks, so its body has to hold what they rely on: 
+	// a solid border, known materials, a distance field that matches the walls and a pyramid that matches the bits below it.
+	bool IsLevelFileBodyValid(const std::uint32_t* wall_bits, const std::uint8_t* materials, const std::uint8_t* distances, 
+		const std::vector<const std::uint32_t*>& pyramid_bits, const std::vector<int>& pyramid_col_counts, 
+		int padded_col_count, int padded_row_count, int material_count)
+	{
+		for (int x = 0; x < padded_col_count; ++x)
+		{
+			if (!GetBit(wall_bits, x) || !GetBit(wall_bits, (padded_row_count - 1) * padded_col_count + x))
+			{
+				return false;
+			}
+		}
+
+		for (int y = 0; y < padded_row_count; ++y)
+		{
+			if (!GetBit(wall_bits, y * padded_col_count) || !GetBit(wall_bits, y * padded_col_count + padded_col_count - 1))
+			{
+				return false;
+			}
+		}
+
+		const int padded_count = padded_col_count * padded_row_count;
+
+		for (int index = 0; index < padded_count; ++index)
+		{
+			if (materials[index] >= material_count)
+			{
+				return false;
+			}
+		}
+
+		// Walls are 0 and every other tile is one more than its nearest neighbour, capped at 255; 
+		// the Chebyshev distance is the only field that holds this everywhere.
+		for (int y = 0; y < padded_row_count; ++y)
+		{
+			for (int x = 0; x < padded_col_count; ++x)
+			{
+				const int index = y * padded_col_count + x;
+
+				if (GetBit(wall_bits, index))
+				{
+					if (distances[index] != 0)
+					{
+						return false;
+					}
+
+					continue;
+				}
+
+				// Border tiles are walls, so a free tile has all eight neighbours.
+				const int above = index - padded_col_count;
+				const int below = index + padded_col_count;
+				const int nearest = std::min({ distances[above - 1], distances[above], distances[above + 1], distances[index - 1], 
+					distances[index + 1], distances[below - 1], distances[below], distances[below + 1] });
+
+				if (distances[index] != std::min(nearest + 1, UINT8_MAX))
+				{
+					return false;
+				}
+			}
+		}
+
+		const std::uint32_t* bits_below = wall_bits;
+		int col_count_below = padded_col_count;
+		int row_count_below = padded_row_count;
+
+		for (std::size_t level = 0; level < pyramid_bits.size(); ++level)
+		{
+			const int col_count = pyramid_col_counts[level];
+			const int row_count = (row_count_below + 3) / 4;
+			std::vector<std::uint32_t> bits((static_cast<std::int64_t>(col_count) * row_count + 31) / 32, 0);
+
+			for (int y = 0; y < row_count_below; ++y)
+			{
+				for (int x = 0; x < col_count_below; ++x)
+				{
+					if (GetBit(bits_below, y * col_count_below + x))
+					{
+						const int index = (y / 4) * col_count + (x / 4);
+						bits[index >> 5] |= 1u << (index & 31);
+					}
+				}
+			}
+
+			for (int index = 0; index < col_count * row_count; ++index)
+			{
+				if (GetBit(bits.data(), index) != GetBit(pyramid_bits[level], index))
+				{
+					return false;
+				}
+			}
+
+			bits_below = pyramid_bits[level];
+			col_count_below = col_count;
+			row_count_below = row_count;
+		}
+
+		return true;
+	}
+} // namespace
 
 Level::Level(Game* game, Screen* screen) :
 	game_(game), 
 	screen_(screen), 
 	surface_pixels_(nullptr), 
 	pixels_(nullptr), 
+	minimap_(std::make_unique<Minimap>(game, this)), 
+	wall_bits_(nullptr), 
+	materials_(nullptr), 
+	distances_(nullptr), 
+	file_(std::make_unique<LevelFile>()), 
+	padded_col_count_(0), 
+	generation_(0), 
 	tiles_col_count_(0), 
 	tiles_row_count_(0), 
 	tiles_count_(0), 
 	tile_size_(1)
 {
-	std::srand(std::time(nullptr));
 }
 	
 Level::~Level()
@@ -31,18 +160,9 @@ void Level::HandleEvents()
 
 }
 
-void Level::Tick()
+void Level::Tick(const Vect2d<float>& focus)
 {
-	std::for_each(board_.begin(), board_.end(), [this](Tile tile)
-	{
-		int scale_factor = 16;
-		tile.rect_.x *= scale_factor;
-		tile.rect_.y *= scale_factor;
-		tile.rect_.w *= scale_factor;
-		tile.rect_.h *= scale_factor;
-
-		screen_->bitmap_->DrawFillRect(tile.rect_.x, tile.rect_.y, tile.rect_.x + tile.rect_.w, tile.rect_.y + tile.rect_.h, game_->GetColor(tile.color_));
-	});
+	minimap_->Draw(*screen_->bitmap_, focus);
 }
 
 bool Level::Load(const char* path)
@@ -57,26 +177,43 @@ bool Level::Load(const char* path)
 		return false;
 	}
 
-	surface_pixels_ = SDL_ConvertSurfaceFormat(surface_pixels_, SDL_GetWindowPixelFormat(game_->window_), 0);
+	if ((surface_pixels_->w + 2LL) * (surface_pixels_->h + 2LL) > constants::max_padded_tile_count)
+	{
+		printf("Level image %s is too large!\n", path);
+		Free();
+		return false;
+	}
+
+	// The converter runs without a window and takes the format frames are drawn in.
+	const Uint32 pixel_format = game_->window_ != nullptr ? SDL_GetWindowPixelFormat(game_->window_) : SDL_PIXELFORMAT_ARGB8888;
+	surface_pixels_ = SDL_ConvertSurfaceFormat(surface_pixels_, pixel_format, 0);
 
 	tiles_col_count_ = surface_pixels_->w;
 	tiles_row_count_ = surface_pixels_->h;
-	tiles_count_ = tiles_col_count_ * tiles_row_count_;
+	tiles_count_ = static_cast<std::int64_t>(tiles_col_count_) * tiles_row_count_;
 
 	return true;
 }
 
 bool Level::Initialize(const char* path)
 {
+	if (HasExtension(path, level_file_extension))
+	{
+		return LoadLevelFile(path);
+	}
+
+	if (HasExtension(path, level_chunk_file_extension))
+	{
+		return LoadLevelChunks(path);
+	}
+
 	if (!Load(path))
 	{
 		return false;
 	}
 
 	board_.resize(GetPixelCount());
-
-	int tile_x = 0;
-	int tile_y = 0;
+	minimap_->Invalidate();
 
 	for (int x = 0; x < tiles_col_count_; ++x)
 	{
@@ -99,164 +236,421 @@ bool Level::Initialize(const char* path)
 			board_[index].color_.g = rgb.g;
 			board_[index].color_.b = rgb.b;
 			board_[index].color_.a = 0xff;
-			board_[index].rect_.x = tile_x;
-			board_[index].rect_.y = tile_y;
-			board_[index].rect_.w = tile_size_;
-			board_[index].rect_.h = tile_size_;
-			
-			tile_y += tile_size_;
 		}
-		
-		tile_x += tile_size_;
-		tile_y = 0;
 	}
 
+	BoardChanged();
+
 	return true;
 }
 
-void Level::GenerateMazeHuntAndKill()
+bool Level::LoadLevelFile(const char* path)
 {
-	tiles_col_count_ = 29;
-	tiles_row_count_ = 27;
+	// Opened next to the current level, which still reads from its own file until this one turns out fine.
+	std::unique_ptr<LevelFile> file = std::make_unique<LevelFile>();
 
-	tiles_col_count_ -= tiles_col_count_ % 2;
-	++tiles_col_count_;
+	if (!file->Open(path))
+	{
+		return false;
+	}
 
-	tiles_row_count_ -= tiles_row_count_ % 2;
-	++tiles_row_count_;
+	const LevelFileHeader& header = file->GetHeader();
+	const int col_count = header.col_count_;
+	const int row_count = header.row_count_;
 
-	tiles_count_ = tiles_col_count_ * tiles_row_count_;
+	// The pyramid's levels follow from the map's size, so only their total size needs checking before the body is.
+	std::vector<const std::uint32_t*> pyramid_bits;
+	std::vector<int> pyramid_col_counts;
+	std::uint64_t pyramid_size = 0;
+	int col_count_below = col_count + 2;
+	int row_count_below = row_count + 2;
 
-	board_.clear();
-	board_.resize(tiles_count_);
+	while (col_count_below > 1 || row_count_below > 1)
+	{
+		col_count_below = (col_count_below + 3) / 4;
+		row_count_below = (row_count_below + 3) / 4;
+		pyramid_bits.push_back(reinterpret_cast<const std::uint32_t*>(file->GetData(header.pyramid_offset_ + pyramid_size)));
+		pyramid_col_counts.push_back(col_count_below);
+		pyramid_size += AlignLevelFileOffset((static_cast<std::uint64_t>(col_count_below) * row_count_below + 31) / 32 * sizeof(std::uint32_t));
+	}
 
-	int tile_x = 0;
-	int tile_y = 0;
+	if (pyramid_size > file->GetSize() - header.pyramid_offset_ || 
+		!IsLevelFileBodyValid(reinterpret_cast<const std::uint32_t*>(file->GetData(header.wall_bits_offset_)), file->GetData(header.materials_offset_), 
+			file->GetData(header.distances_offset_), pyramid_bits, pyramid_col_counts, col_count + 2, row_count + 2, header.material_count_))
+	{
+		printf("Level %s is damaged!\n", path);
+		return false;
+	}
+
+	Free();
+
+	tiles_col_count_ = col_count;
+	tiles_row_count_ = row_count;
+	tiles_count_ = static_cast<std::int64_t>(col_count) * row_count;
+	padded_col_count_ = col_count + 2;
+
+	wall_bits_ = reinterpret_cast<const std::uint32_t*>(file->GetData(header.wall_bits_offset_));
+	materials_ = file->GetData(header.materials_offset_);
+	distances_ = file->GetData(header.distances_offset_);
+	pyramid_bits_ = std::move(pyramid_bits);
+	pyramid_col_counts_ = std::move(pyramid_col_counts);
+
+	// Only the small material table is copied out, since its textures and shades depend on this run.
+	SetMaterialColors(reinterpret_cast<const SDL_Color*>(file->GetData(header.material_colors_offset_)), header.material_count_);
+
+	// A mapped level has no board; whatever was built for the last one goes.
+	std::vector<Tile>().swap(board_);
+	std::vector<std::uint32_t>().swap(owned_wall_bits_);
+	std::vector<std::uint8_t>().swap(owned_materials_);
+	std::vector<std::uint8_t>().swap(owned_distances_);
+	owned_pyramid_bits_.clear();
+	chunks_.reset();
+	file_ = std::move(file);
+
+	minimap_->Invalidate();
+	++generation_;
+
+	return true;
+}
 
-	for (int y = 0; y < tiles_row_count_; ++y)
+bool Level::LoadLevelChunks(const char* path)
+{
+	std::unique_ptr<LevelChunkStore> chunks = std::make_unique<LevelChunkStore>();
+
+	if (!chunks->Open(path, game_->chunk_memory_budget_))
 	{
-		for (int x = 0; x < tiles_col_count_; ++x)
-		{
-			const int index = y * tiles_col_count_ + x;
-			
-			board_[index].is_wall_ = true;
-			board_[index].color_.r = 0x00;
-			board_[index].color_.g = 0xff;
-			board_[index].color_.b = 0x00;
-			board_[index].color_.a = 0xff;
-			board_[index].rect_.x = tile_x;
-			board_[index].rect_.y = tile_y;
-			board_[index].rect_.w = tile_size_;
-			board_[index].rect_.h = tile_size_;
+		return false;
+	}
 
-			if (x == 0 || x == tiles_col_count_ - 1 || y == 0 || y == tiles_row_count_ - 1)
-			{
-				board_[index].color_.r = 0xff;
-				board_[index].color_.g = 0x00;
-				board_[index].color_.b = 0x00;
-			}
+	Free();
 
-			tile_x += tile_size_;
+	tiles_col_count_ = chunks->GetColumnCount();
+	tiles_row_count_ = chunks->GetRowCount();
+	tiles_count_ = static_cast<std::int64_t>(tiles_col_count_) * tiles_row_count_;
+	padded_col_count_ = tiles_col_count_ + 2;
+
+	SetMaterialColors(chunks->GetMaterialColors().data(), chunks->GetMaterialColors().size());
+
+	wall_bits_ = nullptr;
+	materials_ = nullptr;
+	distances_ = nullptr;
+	pyramid_bits_.clear();
+	pyramid_col_counts_.clear();
+	std::vector<Tile>().swap(board_);
+	std::vector<std::uint32_t>().swap(owned_wall_bits_);
+	std::vector<std::uint8_t>().swap(owned_materials_);
+	std::vector<std::uint8_t>().swap(owned_distances_);
+	owned_pyramid_bits_.clear();
+	file_->Close();
+	chunks_ = std::move(chunks);
+
+	minimap_->Invalidate();
+	++generation_;
 
-		}
+	return true;
+}
+
+bool Level::Save(const char* path)
+{
+	static_assert(sizeof(SDL_Color) == 4, "Material colours are stored as four bytes.");
 
-		tile_y += tile_size_;
-		tile_x = 0;
+	if (HasExtension(path, level_chunk_file_extension))
+	{
+		return SaveChunks(path);
 	}
 
-	int current_tile_index = 1 * tiles_col_count_ + 1;
+	if (wall_bits_ == nullptr)
+	{
+		printf("Only chunked levels can be written from a chunked level, not %s!\n", path);
+		return false;
+	}
 
-	while (!BoardComplete())
+	const std::uint64_t padded_count = static_cast<std::uint64_t>(padded_col_count_) * (tiles_row_count_ + 2);
+	const std::uint64_t wall_bits_size = (padded_count + 31) / 32 * sizeof(std::uint32_t);
+
+	LevelFileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic_, level_file_magic, sizeof(level_file_magic));
+	header.version_ = level_file_version;
+	header.col_count_ = tiles_col_count_;
+	header.row_count_ = tiles_row_count_;
+	header.material_count_ = static_cast<std::uint32_t>(material_colors_.size());
+	header.material_colors_offset_ = AlignLevelFileOffset(sizeof(header));
+	header.wall_bits_offset_ = AlignLevelFileOffset(header.material_colors_offset_ + material_colors_.size() * sizeof(SDL_Color));
+	header.materials_offset_ = AlignLevelFileOffset(header.wall_bits_offset_ + wall_bits_size);
+	header.distances_offset_ = AlignLevelFileOffset(header.materials_offset_ + padded_count);
+	header.pyramid_offset_ = AlignLevelFileOffset(header.distances_offset_ + padded_count);
+	header.file_size_ = header.pyramid_offset_;
+
+	std::vector<std::uint64_t> pyramid_sizes;
+	int row_count = tiles_row_count_ + 2;
+
+	for (int col_count : pyramid_col_counts_)
 	{
-		DeleteWall(current_tile_index);
-		const std::vector<int>& neighbor_indices = GetNeighborTilesIndices(current_tile_index);
+		row_count = (row_count + 3) / 4;
+		pyramid_sizes.push_back((col_count * row_count + 31) / 32 * sizeof(std::uint32_t));
+		header.file_size_ += AlignLevelFileOffset(pyramid_sizes.back());
+	}
 
-		const bool all_uncovered = std::all_of(neighbor_indices.begin(), neighbor_indices.end(), [this](int neighbor_index)
-			{
-				return !board_[neighbor_index].is_wall_;
-			});
+	std::vector<std::uint8_t> bytes(header.file_size_, 0);
+	std::memcpy(bytes.data(), &header, sizeof(header));
+	std::memcpy(bytes.data() + header.material_colors_offset_, material_colors_.data(), material_colors_.size() * sizeof(SDL_Color));
+	std::memcpy(bytes.data() + header.wall_bits_offset_, wall_bits_, wall_bits_size);
+	std::memcpy(bytes.data() + header.materials_offset_, materials_, padded_count);
+	std::memcpy(bytes.data() + header.distances_offset_, distances_, padded_count);
+
+	std::uint64_t offset = header.pyramid_offset_;
 
-		if (neighbor_indices.empty() || all_uncovered)
+	for (std::size_t level = 0; level < pyramid_bits_.size(); ++level)
+	{
+		std::memcpy(bytes.data() + offset, pyramid_bits_[level], pyramid_sizes[level]);
+		offset += AlignLevelFileOffset(pyramid_sizes[level]);
+	}
+
+	std::FILE* file = std::fopen(path, "wb");
+
+	if (file == nullptr)
+	{
+		printf("Unable to write level %s!\n", path);
+		return false;
+	}
+
+	const bool written = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	
+	if (std::fclose(file) != 0 || !written)
+	{
+		printf("Unable to write level %s!\n", path);
+		return false;
+	}
+
+	return true;
+}
+
+bool Level::SaveChunks(const char* path)
+{
+	LevelChunkFileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic_, level_chunk_file_magic, sizeof(level_chunk_file_magic));
+	header.version_ = level_chunk_file_version;
+	header.col_count_ = tiles_col_count_;
+	header.row_count_ = tiles_row_count_;
+	header.material_count_ = static_cast<std::uint32_t>(material_colors_.size());
+	header.chunk_size_ = level_chunk_size;
+	header.material_colors_offset_ = AlignLevelFileOffset(sizeof(header));
+	header.chunks_offset_ = AlignLevelFileOffset(header.material_colors_offset_ + material_colors_.size() * sizeof(SDL_Color));
+
+	std::FILE* file = std::fopen(path, "wb");
+
+	if (file == nullptr)
+	{
+		printf("Unable to write level %s!\n", path);
+		return false;
+	}
+
+	std::vector<std::uint8_t> head(header.chunks_offset_, 0);
+	std::memcpy(head.data(), &header, sizeof(header));
+	std::memcpy(head.data() + header.material_colors_offset_, material_colors_.data(), material_colors_.size() * sizeof(SDL_Color));
+	bool written = std::fwrite(head.data(), 1, head.size(), file) == head.size();
+
+	// One chunk at a time, through the same lookups the ray tracers use, so any level can be rechunked.
+	const std::unique_ptr<LevelChunk> chunk = std::make_unique<LevelChunk>();
+
+	for (int chunk_y = 0; written && chunk_y < tiles_row_count_; chunk_y += level_chunk_size)
+	{
+		for (int chunk_x = 0; written && chunk_x < tiles_col_count_; chunk_x += level_chunk_size)
 		{
-			bool found = false;
+			std::memset(chunk.get(), 0, sizeof(LevelChunk));
 
-			for (int y = 1; y < tiles_row_count_; y += 2)
+			for (int y = 0; y < level_chunk_size; ++y)
 			{
-				for (int x = 1; x < tiles_col_count_; x += 2)
+				for (int x = 0; x < level_chunk_size; ++x)
 				{
-					const int index = y * tiles_col_count_ + x;
+					const int index = y * level_chunk_size + x;
+					const bool inside = chunk_x + x < tiles_col_count_ && chunk_y + y < tiles_row_count_;
 
-					if (!board_[index].is_wall_)
+					if (!inside || IsWall(chunk_x + x, chunk_y + y))
 					{
-						continue;
+						chunk->wall_bits_[index >> 5] |= 1u << (index & 31);
 					}
 
-					for (int neighbor_index : GetNeighborTilesIndices(index))
+					if (inside)
 					{
-						if (board_[neighbor_index].is_wall_)
-						{
-							continue;	
-						}
-						
-						const int delta = (neighbor_index - index) / 2;
-						DeleteWall(neighbor_index);
-						DeleteWall(index + delta);
-						current_tile_index = index;
-						break;
-					}
-
-					if (current_tile_index == index)
-					{
-						found = true;
-						break;
+						chunk->materials_[index] = GetMaterial(chunk_x + x, chunk_y + y);
+						chunk->distances_[index] = static_cast<std::uint8_t>(GetDistance(chunk_x + x, chunk_y + y));
 					}
 				}
-				
-				if (found)
-				{
-					break;
-				}
 			}
+
+			written = std::fwrite(chunk.get(), sizeof(LevelChunk), 1, file) == 1;
 		}
-		else
+	}
+
+	if (std::fclose(file) != 0 || !written)
+	{
+		printf("Unable to write level %s!\n", path);
+		return false;
+	}
+
+	return true;
+}
+
+void Level::SetMaterialColors(const SDL_Color* colors, std::size_t count)
+{
+	material_colors_.assign(colors, colors + count);
+	material_textures_.assign(1, nullptr);
+	material_shades_.clear();
+	AddMaterialShades(material_colors_[0]);
+
+	for (std::size_t i = 1; i < material_colors_.size(); ++i)
+	{
+		material_textures_.push_back(game_->GetWallTexture(material_colors_[i]));
+		AddMaterialShades(material_colors_[i]);
+	}
+}
+
+void Level::GenerateMazeHuntAndKill(int col_count, int row_count, std::uint32_t seed)
+{
+	ResetMazeBoard(col_count, row_count);
+
+	std::mt19937 random(seed);
+	CarveMaze({ 0, 0, tiles_col_count_ / 2, tiles_row_count_ / 2 }, random);
+
+	BoardChanged();
+
+	game_->player_->SetPos({ 1.5f, 1.5f });
+}
+
+void Level::GenerateMazeChunked(int col_count, int row_count, std::uint32_t seed, int chunk_size)
+{
+	ResetMazeBoard(col_count, row_count);
+
+	chunk_size = std::max(chunk_size, 1);
+	const int cell_col_count = tiles_col_count_ / 2;
+	const int cell_row_count = tiles_row_count_ / 2;
+	const int chunk_col_count = (cell_col_count + chunk_size - 1) / chunk_size;
+	const int chunk_row_count = (cell_row_count + chunk_size - 1) / chunk_size;
+
+	// A chunk only opens its own cells, the walls between them and the passage on its west or north edge, 
+	// so the chunks can be carved in any order on any thread.
+	game_->thread_pool_->ParallelFor(0, chunk_col_count * chunk_row_count, 1, [this, seed, chunk_size, chunk_col_count, cell_col_count, cell_row_count](int band_begin, int band_end, std::size_t)
+	{
+		for (int chunk = band_begin; chunk < band_end; ++chunk)
 		{
-			int random_neighbor_index = -1;
-			
-			do 
+			const int chunk_x = chunk % chunk_col_count;
+			const int chunk_y = chunk / chunk_col_count;
+			const SDL_Rect cells = { chunk_x * chunk_size, chunk_y * chunk_size, std::min(chunk_size, cell_col_count - chunk_x * chunk_size), std::min(chunk_size, cell_row_count - chunk_y * chunk_size) };
+
+			// Seeded per chunk, so the maze is the same however the chunks are spread over the threads.
+			std::seed_seq chunk_seed = { seed, static_cast<std::uint32_t>(chunk) };
+			std::mt19937 random(chunk_seed);
+			CarveMaze(cells, random);
+
+			if (chunk_x == 0 && chunk_y == 0)
 			{
-				random_neighbor_index = neighbor_indices[std::rand() % neighbor_indices.size()];
+				continue;
 			}
-			while (!board_[random_neighbor_index].is_wall_);
-
-			const int delta = (random_neighbor_index - current_tile_index) / 2;
-			
-			DeleteWall(random_neighbor_index);
-			DeleteWall(current_tile_index + delta);
 
-			current_tile_index = random_neighbor_index;
+			// Every other chunk joins its west or north neighbour, which links the chunks into a tree 
+			// and keeps the whole maze connected without loops.
+			if (chunk_x > 0 && (chunk_y == 0 || random() % 2 == 0))
+			{
+				const int cell_y = cells.y + static_cast<int>(random() % cells.h);
+				OpenTile((2 * cell_y + 1) * tiles_col_count_ + 2 * cells.x);
+			}
+			else
+			{
+				const int cell_x = cells.x + static_cast<int>(random() % cells.w);
+				OpenTile(2 * cells.y * tiles_col_count_ + 2 * cell_x + 1);
+			}
 		}
-	}
+	});
+
+	BoardChanged();
 
 	game_->player_->SetPos({ 1.5f, 1.5f });
 }
 
-bool Level::BoardComplete()
+void Level::ResetMazeBoard(int col_count, int row_count)
 {
-	for (int y = 1; y < tiles_row_count_; y += 2)
+	// Cells sit on odd coordinates with a wall tile between every two of them, so both sides are odd.
+	col_count = std::min(col_count, constants::max_maze_side);
+	row_count = std::min(row_count, constants::max_maze_side);
+	tiles_col_count_ = std::max(3, col_count - col_count % 2 + 1);
+	tiles_row_count_ = std::max(3, row_count - row_count % 2 + 1);
+	tiles_count_ = static_cast<std::int64_t>(tiles_col_count_) * tiles_row_count_;
+
+	const Tile wall = { true, { 0x00, 0xff, 0x00, 0xff } };
+	const Tile border = { true, { 0xff, 0x00, 0x00, 0xff } };
+
+	board_.assign(tiles_count_, wall);
+	minimap_->Invalidate();
+
+	std::fill_n(board_.begin(), tiles_col_count_, border);
+	std::fill_n(board_.end() - tiles_col_count_, tiles_col_count_, border);
+
+	for (int y = 1; y < tiles_row_count_ - 1; ++y)
 	{
-		for (int x = 1; x < tiles_col_count_; x += 2)
+		board_[y * tiles_col_count_] = border;
+		board_[y * tiles_col_count_ + tiles_col_count_ - 1] = border;
+	}
+}
+
+void Level::CarveMaze(const SDL_Rect& cells, std::mt19937& random)
+{
+	std::array<int, 4> neighbor_indices;
+	// Cells still walled in. Every cell before the hunt cursor, counted row by row, has been visited.
+	int unvisited_count = cells.w * cells.h - 1;
+	int hunt_cursor = 0;
+
+	const auto get_cell_tile_index = [this, &cells](int cell)
+	{
+		return (2 * (cells.y + cell / cells.w) + 1) * tiles_col_count_ + 2 * (cells.x + cell % cells.w) + 1;
+	};
+
+	int current_tile_index = get_cell_tile_index(0);
+	OpenTile(current_tile_index);
+
+	while (unvisited_count > 0)
+	{
+		const int neighbor_count = GetNeighborTilesIndices(current_tile_index, cells, neighbor_indices);
+		int unvisited_neighbor_count = 0;
+
+		for (int i = 0; i < neighbor_count; ++i)
 		{
-			if (board_[y * tiles_col_count_ + x].is_wall_)
+			if (board_[neighbor_indices[i]].is_wall_)
 			{
-				return false;
+				neighbor_indices[unvisited_neighbor_count++] = neighbor_indices[i];
 			}
 		}
-	}
 
-	return true;
+		int next_tile_index = -1;
+		int visited_tile_index = current_tile_index;
+
+		if (unvisited_neighbor_count > 0)
+		{
+			next_tile_index = neighbor_indices[random() % unvisited_neighbor_count];
+		}
+		else
+		{
+			while (!board_[get_cell_tile_index(hunt_cursor)].is_wall_)
+			{
+				++hunt_cursor;
+			}
+
+			// The first walled-in cell borders a visited one to its north, or to its west on the first row.
+			next_tile_index = get_cell_tile_index(hunt_cursor);
+			visited_tile_index = hunt_cursor >= cells.w ? next_tile_index - 2 * tiles_col_count_ : next_tile_index - 2;
+		}
+
+		// Halving the difference rather than the sum, which would overflow on the largest mazes.
+		OpenTile(visited_tile_index + (next_tile_index - visited_tile_index) / 2);
+		OpenTile(next_tile_index);
+		--unvisited_count;
+		current_tile_index = next_tile_index;
+	}
 }
 
-void Level::DeleteWall(std::size_t index)
+void Level::OpenTile(std::size_t index)
 {
 	board_[index].is_wall_ = false;
 	board_[index].color_.r = 0x00;
@@ -264,36 +658,354 @@ void Level::DeleteWall(std::size_t index)
 	board_[index].color_.b = 0x00;
 }
 
-std::vector<int> Level::GetNeighborTilesIndices(int index)
+bool Level::DeleteWall(int x, int y)
 {
-	std::vector<int> result;
+	// Binary and chunked levels have no board, and their ray data lives in the file.
+	if (board_.empty())
+	{
+		printf("Only generated levels and level images can be edited!\n");
+		return false;
+	}
+
+	if (x < 0 || y < 0 || x >= tiles_col_count_ || y >= tiles_row_count_ || !IsWall(x, y))
+	{
+		return false;
+	}
+
+	OpenTile(y * tiles_col_count_ + x);
 
-	const int north_neighbor_index = index - (2 * tiles_col_count_);
-	const int east_neighbor_index = index + 2;
-	const int south_neighbor_index = index + (2 * tiles_col_count_);
-	const int west_neighbor_index = index - 2;
+	const int index = GetPaddedIndex(x, y);
+	owned_wall_bits_[index >> 5] &= ~(1u << (index & 31));
+	owned_materials_[index] = 0;
 
-	if (index > (tiles_col_count_ * 3 - 1))
+	// Only tiles that had this wall as their nearest one move away from a wall. They lie inside the first ring around 
+	// it whose tiles are all nearer to another wall, which keeps its distances and seeds the transform within.
+	const auto ring_keeps_distances = [this, x, y](int radius)
 	{
-		result.push_back(north_neighbor_index);
+		for (int ring_y = y - radius; ring_y <= y + radius; ++ring_y)
+		{
+			const int step = ring_y == y - radius || ring_y == y + radius ? 1 : 2 * radius;
+
+			for (int ring_x = x - radius; ring_x <= x + radius; ring_x += step)
+			{
+				const bool inside = ring_x >= 0 && ring_y >= 0 && ring_x < tiles_col_count_ && ring_y < tiles_row_count_;
+
+				if (inside && GetDistance(ring_x, ring_y) >= radius)
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	};
+
+	// Distances stop at UINT8_MAX, so the ring is found at the latest one tile beyond that.
+	int radius = 1;
+
+	while (!ring_keeps_distances(radius))
+	{
+		++radius;
 	}
 
-	if ((index - (tiles_col_count_ - 2)) % tiles_col_count_ != 0 && (index - (tiles_col_count_ - 3)) % tiles_col_count_ != 0)
+	const int begin_x = std::max(x - radius + 1, 0);
+	const int begin_y = std::max(y - radius + 1, 0);
+	const int end_x = std::min(x + radius, tiles_col_count_);
+	const int end_y = std::min(y + radius, tiles_row_count_);
+	UpdateDistances({ begin_x, begin_y, end_x - begin_x, end_y - begin_y });
+	UpdatePyramid(x, y);
+
+	minimap_->MarkTileDirty(x, y);
+	++generation_;
+
+	return true;
+}
+
+void Level::BoardChanged()
+{
+	// Built from board_ alone, so a chunked level read so far is done with.
+	chunks_.reset();
+	BuildOccupancy();
+	BuildDistanceField();
+	BuildPyramid();
+	// Nothing points into a mapped level any more.
+	file_->Close();
+	++generation_;
+}
+
+void Level::BuildOccupancy()
+{
+	padded_col_count_ = tiles_col_count_ + 2;
+	const std::int64_t padded_count = static_cast<std::int64_t>(padded_col_count_) * (tiles_row_count_ + 2);
+
+	owned_wall_bits_.assign((padded_count + 31) / 32, 0);
+	owned_materials_.assign(padded_count, 0);
+	wall_bits_ = owned_wall_bits_.data();
+	materials_ = owned_materials_.data();
+	material_colors_.assign(1, { 0x00, 0x00, 0x00, 0xff });
+	material_textures_.assign(1, nullptr);
+	material_shades_.clear();
+	AddMaterialShades(material_colors_[0]);
+
+	for (int y = -1; y <= tiles_row_count_; ++y)
 	{
-		result.push_back(east_neighbor_index);
+		for (int x = -1; x <= tiles_col_count_; ++x)
+		{
+			const int index = GetPaddedIndex(x, y);
+			const bool border = x < 0 || y < 0 || x >= tiles_col_count_ || y >= tiles_row_count_;
+
+			if (border)
+			{
+				owned_wall_bits_[index >> 5] |= 1u << (index & 31);
+				continue;
+			}
+
+			const Tile& tile = board_[y * tiles_col_count_ + x];
+
+			if (tile.is_wall_)
+			{
+				owned_wall_bits_[index >> 5] |= 1u << (index & 31);
+				owned_materials_[index] = GetMaterialIndex(tile.color_);
+			}
+		}
 	}
+}
+
+void Level::BuildDistanceField()
+{
+	owned_distances_.assign(owned_materials_.size(), 0);
+	distances_ = owned_distances_.data();
 
-	if (index < (tiles_col_count_ * (tiles_row_count_ - 3) - 1))
+	// The padded border around the map is all walls.
+	UpdateDistances({ 0, 0, tiles_col_count_, tiles_row_count_ });
+}
+
+void Level::UpdateDistances(const SDL_Rect& tiles)
+{
+	// Two-pass chamfer transform; with unit costs on all eight neighbours it is exact for Chebyshev distance, 
+	// also when the tiles around the rectangle start it off with their own distances.
+	for (int y = tiles.y; y < tiles.y + tiles.h; ++y)
 	{
-		result.push_back(south_neighbor_index);
+		for (int x = tiles.x; x < tiles.x + tiles.w; ++x)
+		{
+			if (IsWall(x, y))
+			{
+				continue;
+			}
+
+			const int nearest = std::min({ GetDistance(x - 1, y), GetDistance(x - 1, y - 1), GetDistance(x, y - 1), GetDistance(x + 1, y - 1) });
+			owned_distances_[GetPaddedIndex(x, y)] = static_cast<std::uint8_t>(std::min(nearest + 1, UINT8_MAX));
+		}
 	}
 
-	if ((index - 1) % tiles_col_count_ != 0 && (index - 2) % tiles_col_count_ != 0)
+	for (int y = tiles.y + tiles.h - 1; y >= tiles.y; --y)
 	{
-		result.push_back(west_neighbor_index);
+		for (int x = tiles.x + tiles.w - 1; x >= tiles.x; --x)
+		{
+			if (IsWall(x, y))
+			{
+				continue;
+			}
+
+			const int nearest = std::min({ GetDistance(x + 1, y), GetDistance(x + 1, y + 1), GetDistance(x, y + 1), GetDistance(x - 1, y + 1) });
+			owned_distances_[GetPaddedIndex(x, y)] = static_cast<std::uint8_t>(std::min({ GetDistance(x, y), nearest + 1, UINT8_MAX }));
+		}
+	}
+}
+
+void Level::BuildPyramid()
+{
+	pyramid_bits_.clear();
+	owned_pyramid_bits_.clear();
+	pyramid_col_counts_.clear();
+
+	const std::uint32_t* bits_below = wall_bits_;
+	int col_count_below = padded_col_count_;
+	int row_count_below = tiles_row_count_ + 2;
+
+	// Each level ORs together 4x4 cells of the one below until a single block covers the whole map.
+	while (col_count_below > 1 || row_count_below > 1)
+	{
+		const int col_count = (col_count_below + 3) / 4;
+		const int row_count = (row_count_below + 3) / 4;
+		std::vector<std::uint32_t> bits((col_count * row_count + 31) / 32, 0);
+
+		for (int y = 0; y < row_count_below; ++y)
+		{
+			for (int x = 0; x < col_count_below; ++x)
+			{
+				const int index_below = y * col_count_below + x;
+
+				if ((bits_below[index_below >> 5] >> (index_below & 31)) & 1)
+				{
+					const int index = (y / 4) * col_count + (x / 4);
+					bits[index >> 5] |= 1u << (index & 31);
+				}
+			}
+		}
+
+		owned_pyramid_bits_.push_back(std::move(bits));
+		pyramid_bits_.push_back(owned_pyramid_bits_.back().data());
+		pyramid_col_counts_.push_back(col_count);
+
+		bits_below = pyramid_bits_.back();
+		col_count_below = col_count;
+		row_count_below = row_count;
+	}
+}
+
+void Level::UpdatePyramid(int x, int y)
+{
+	int col_count_below = padded_col_count_;
+	int row_count_below = tiles_row_count_ + 2;
+	int block_x = x + 1;
+	int block_y = y + 1;
+
+	// Climbs while the block around the tile has just lost its last wall.
+	for (std::size_t level = 0; level < owned_pyramid_bits_.size(); ++level)
+	{
+		const std::uint32_t* bits_below = level == 0 ? wall_bits_ : pyramid_bits_[level - 1];
+		block_x /= 4;
+		block_y /= 4;
+
+		for (int y_below = 4 * block_y; y_below < std::min(4 * block_y + 4, row_count_below); ++y_below)
+		{
+			for (int x_below = 4 * block_x; x_below < std::min(4 * block_x + 4, col_count_below); ++x_below)
+			{
+				const int index_below = y_below * col_count_below + x_below;
+
+				if ((bits_below[index_below >> 5] >> (index_below & 31)) & 1)
+				{
+					return;
+				}
+			}
+		}
+
+		const int index = block_y * pyramid_col_counts_[level] + block_x;
+		owned_pyramid_bits_[level][index >> 5] &= ~(1u << (index & 31));
+
+		col_count_below = pyramid_col_counts_[level];
+		row_count_below = (row_count_below + 3) / 4;
+	}
+}
+
+bool Level::GetEmptyReach(int x, int y, int step_x, int step_y, bool use_distances, bool use_pyramid, int& reach_x, int& reach_y) const
+{
+	reach_x = 0;
+	reach_y = 0;
+
+	if (use_pyramid)
+	{
+		const int padded_x = x + 1;
+		const int padded_y = y + 1;
+		int empty_shift = 0;
+
+		// Climb while the enclosing block is still empty; the last empty one is the biggest safe box.
+		for (std::size_t level = 0; level < pyramid_bits_.size(); ++level)
+		{
+			const int shift = 2 * static_cast<int>(level + 1);
+			const int index = (padded_y >> shift) * pyramid_col_counts_[level] + (padded_x >> shift);
+
+			if ((pyramid_bits_[level][index >> 5] >> (index & 31)) & 1)
+			{
+				break;
+			}
+
+			empty_shift = shift;
+		}
+
+		if (empty_shift > 0)
+		{
+			const int block_mask = (1 << empty_shift) - 1;
+			reach_x = step_x > 0 ? block_mask - (padded_x & block_mask) : (padded_x & block_mask);
+			reach_y = step_y > 0 ? block_mask - (padded_y & block_mask) : (padded_y & block_mask);
+		}
+	}
+
+	if (use_distances)
+	{
+		const int reach = GetDistance(x, y) - 1;
+
+		if (reach >= min_skip_distance - 1 && 2 * reach > reach_x + reach_y)
+		{
+			reach_x = reach;
+			reach_y = reach;
+		}
+	}
+
+	return reach_x > 0 || reach_y > 0;
+}
+
+std::uint8_t Level::GetMaterialIndex(const SDL_Color& color)
+{
+	for (std::size_t i = 1; i < material_colors_.size(); ++i)
+	{
+		if (game_->ColorsEqual(material_colors_[i], color))
+		{
+			return static_cast<std::uint8_t>(i);
+		}
+	}
+
+	if (material_colors_.size() > UINT8_MAX)
+	{
+		return 0;
+	}
+
+	material_colors_.push_back(color);
+	material_textures_.push_back(game_->GetWallTexture(color));
+	AddMaterialShades(color);
+	return static_cast<std::uint8_t>(material_colors_.size() - 1);
+}
+
+void Level::AddMaterialShades(const SDL_Color& color)
+{
+	for (int shade = 0; shade < 2 * constants::fog_level_count; ++shade)
+	{
+		const int brightness = constants::fog_level_count - shade / 2;
+		SDL_Color shaded = color;
+
+		shaded.r = shaded.r * brightness / constants::fog_level_count;
+		shaded.g = shaded.g * brightness / constants::fog_level_count;
+		shaded.b = shaded.b * brightness / constants::fog_level_count;
+
+		if (shade % 2 == 1)
+		{
+			shaded.r /= 2;
+			shaded.g /= 2;
+			shaded.b /= 2;
+		}
+
+		material_shades_.push_back(game_->GetColor(shaded));
 	}
-	
-	return result;
+}
+
+int Level::GetNeighborTilesIndices(int index, const SDL_Rect& cells, std::array<int, 4>& neighbor_indices)
+{
+	const int x = index % tiles_col_count_;
+	const int y = index / tiles_col_count_;
+	int count = 0;
+
+	if (y > 2 * cells.y + 1)
+	{
+		neighbor_indices[count++] = index - 2 * tiles_col_count_;
+	}
+
+	if (x < 2 * (cells.x + cells.w) - 1)
+	{
+		neighbor_indices[count++] = index + 2;
+	}
+
+	if (y < 2 * (cells.y + cells.h) - 1)
+	{
+		neighbor_indices[count++] = index + 2 * tiles_col_count_;
+	}
+
+	if (x > 2 * cells.x + 1)
+	{
+		neighbor_indices[count++] = index - 2;
+	}
+
+	return count;
 }
 
 void Level::Free()
@@ -315,7 +1027,7 @@ int Level::GetRowCount()
 	return tiles_row_count_;
 }
 
-int Level::GetPixelCount()
+std::int64_t Level::GetPixelCount()
 {
 	return tiles_count_;
 }
@@ -325,6 +1037,22 @@ int Level::GetTileSize()
 	return tile_size_;
 }
 
+int Level::GetMaxRaySteps() const
+{
+	// A ray crosses every grid line of the padded map at most once before it runs into the border.
+	return padded_col_count_ + tiles_row_count_ + 2;
+}
+
+const std::uint32_t* Level::GetWallBits() const
+{
+	return wall_bits_;
+}
+
+int Level::GetPaddedColumnCount() const
+{
+	return padded_col_count_;
+}
+
 SDL_Surface* Level::GetPixelSurface()
 {
 	return surface_pixels_;
@@ -354,21 +1082,9 @@ Uint32 Level::GetPitch32()
 	return pitch;
 }
 
-Tile* Level::GetTile(int x, int y)
+Minimap& Level::GetMinimap()
 {
-	if (x < 0 || y < 0 || x >= (GetColumnCount() * GetTileSize()) || y >= (GetRowCount() * GetTileSize()))
-	{
-		return nullptr;
-	}
-
-	const int index = (y / tile_size_) * GetColumnCount() + (x / tile_size_);
-
-	if (index < 0 || index >= static_cast<int>(board_.size()))
-	{
-		return nullptr;
-	}
-	
-	return &board_[index];
+	return *minimap_;
 }
 
 // std::vector<Tile*> Level::GetNeighborTiles(int x, int y)
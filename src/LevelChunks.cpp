@@ -0,0 +1,268 @@
+#include "LevelChunks.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// Chunks every thread keeps at hand, four columns by two rows of them; a ray crossing a chunk corner touches four.
+	constexpr int thread_cache_size = 8;
+	// Enough for the chunks around the player and the minimap, whatever the budget.
+	constexpr std::size_t min_resident_count = 64;
+
+	std::atomic<std::uint64_t> next_store_id(1);
+
+	struct CachedChunk
+	{
+		std::uint64_t store_id_;
+		int chunk_index_;
+		// The store's insert count when the chunk was last marked as used.
+		std::uint64_t used_at_;
+		std::shared_ptr<const LevelChunk> chunk_;
+	};
+} // namespace
+
+LevelChunkStore::LevelChunkStore() : 
+	file_(nullptr), 
+	header_(), 
+	chunk_col_count_(0), 
+	chunk_row_count_(0), 
+	max_resident_count_(min_resident_count), 
+	id_(next_store_id++), 
+	load_count_(0), 
+	insert_count_(0)
+{
+}
+
+LevelChunkStore::~LevelChunkStore()
+{
+	if (file_ != nullptr)
+	{
+		std::fclose(file_);
+		file_ = nullptr;
+	}
+}
+
+bool LevelChunkStore::Open(const char* path, std::size_t memory_budget)
+{
+	file_ = std::fopen(path, "rb");
+
+	if (file_ == nullptr)
+	{
+		printf("Unable to open level %s!\n", path);
+		return false;
+	}
+
+	if (std::fread(&header_, sizeof(header_), 1, file_) != 1 || std::memcmp(header_.magic_, level_chunk_file_magic, sizeof(level_chunk_file_magic)) != 0 || 
+		header_.version_ != level_chunk_file_version || header_.chunk_size_ != level_chunk_size)
+	{
+		printf("%s is not a version %u chunked level!\n", path, level_chunk_file_version);
+		return false;
+	}
+
+	material_colors_.resize(header_.material_count_);
+
+	// Chunks are numbered with ints, so their count has to fit one; worked out in 64 bits before the sides are known to be sane.
+	const std::int64_t chunk_count = ((static_cast<std::int64_t>(header_.col_count_) + level_chunk_size - 1) / level_chunk_size) * 
+		((static_cast<std::int64_t>(header_.row_count_) + level_chunk_size - 1) / level_chunk_size);
+
+	if (header_.col_count_ <= 0 || header_.row_count_ <= 0 || header_.col_count_ > level_chunk_max_side || header_.row_count_ > level_chunk_max_side || 
+		chunk_count > INT32_MAX || header_.material_count_ == 0 || header_.material_count_ > 256 || 
+		std::fseek(file_, static_cast<long>(header_.material_colors_offset_), SEEK_SET) != 0 || 
+		std::fread(material_colors_.data(), sizeof(SDL_Color), material_colors_.size(), file_) != material_colors_.size())
+	{
+		printf("Level %s is damaged!\n", path);
+		return false;
+	}
+
+	chunk_col_count_ = (header_.col_count_ + level_chunk_size - 1) / level_chunk_size;
+	chunk_row_count_ = (header_.row_count_ + level_chunk_size - 1) / level_chunk_size;
+	max_resident_count_ = std::max(memory_budget / sizeof(LevelChunk), min_resident_count);
+
+	return true;
+}
+
+std::shared_ptr<const LevelChunk> LevelChunkStore::LoadChunk(int chunk_index)
+{
+	{
+		const std::lock_guard<std::mutex> lock(mutex_);
+		const auto found = resident_index_.find(chunk_index);
+
+		if (found != resident_index_.end())
+		{
+			resident_.splice(resident_.begin(), resident_, found->second);
+			return found->second->second;
+		}
+	}
+
+	// Read without the lock, so threads that only need loaded chunks never wait for the disk.
+	std::shared_ptr<LevelChunk> chunk = std::make_shared<LevelChunk>();
+
+	const auto is_unknown_material = [this](std::uint8_t material) { return material >= header_.material_count_; };
+
+	if (!ReadChunk(chunk_index, *chunk) || std::any_of(std::begin(chunk->materials_), std::end(chunk->materials_), is_unknown_material))
+	{
+		// A chunk that cannot be read, or names materials the level does not have, stays solid, so rays still stop at it.
+		std::fill(std::begin(chunk->wall_bits_), std::end(chunk->wall_bits_), ~0u);
+		std::fill(std::begin(chunk->materials_), std::end(chunk->materials_), 0);
+		std::fill(std::begin(chunk->distances_), std::end(chunk->distances_), 0);
+	}
+
+	const std::lock_guard<std::mutex> lock(mutex_);
+	const auto found = resident_index_.find(chunk_index);
+
+	// Another thread read the same chunk meanwhile; everyone shares its copy.
+	if (found != resident_index_.end())
+	{
+		resident_.splice(resident_.begin(), resident_, found->second);
+		return found->second->second;
+	}
+
+	++load_count_;
+	UseChunk(chunk_index, chunk);
+
+	return chunk;
+}
+
+bool LevelChunkStore::ReadChunk(int chunk_index, LevelChunk& chunk)
+{
+	const std::uint64_t offset = header_.chunks_offset_ + static_cast<std::uint64_t>(chunk_index) * sizeof(LevelChunk);
+
+#if defined(__unix__) || defined(__APPLE__)
+	// pread leaves the file position alone, so threads read their chunks side by side.
+	std::uint8_t* bytes = reinterpret_cast<std::uint8_t*>(&chunk);
+	std::size_t read_count = 0;
+
+	while (read_count < sizeof(LevelChunk))
+	{
+		const ssize_t count = pread(fileno(file_), bytes + read_count, sizeof(LevelChunk) - read_count, static_cast<off_t>(offset + read_count));
+
+		if (count <= 0)
+		{
+			return false;
+		}
+
+		read_count += count;
+	}
+
+	return true;
+#else
+	const std::lock_guard<std::mutex> lock(file_mutex_);
+	return std::fseek(file_, static_cast<long>(offset), SEEK_SET) == 0 && std::fread(&chunk, sizeof(LevelChunk), 1, file_) == 1;
+#endif
+}
+
+void LevelChunkStore::UseChunk(int chunk_index, const std::shared_ptr<const LevelChunk>& chunk)
+{
+	const auto found = resident_index_.find(chunk_index);
+
+	if (found != resident_index_.end())
+	{
+		resident_.splice(resident_.begin(), resident_, found->second);
+		return;
+	}
+
+	++insert_count_;
+	resident_.emplace_front(chunk_index, chunk);
+	resident_index_[chunk_index] = resident_.begin();
+
+	// Thread caches may still hold a dropped chunk, which lives on until they move on from it.
+	while (resident_.size() > max_resident_count_)
+	{
+		resident_index_.erase(resident_.back().first);
+		resident_.pop_back();
+	}
+}
+
+void LevelChunkStore::TouchChunk(int chunk_index, const std::shared_ptr<const LevelChunk>& chunk)
+{
+	const std::lock_guard<std::mutex> lock(mutex_);
+	UseChunk(chunk_index, chunk);
+}
+
+const LevelChunk& LevelChunkStore::GetChunk(int x, int y)
+{
+	thread_local std::array<CachedChunk, thread_cache_size> cache;
+
+	const int chunk_x = x >> level_chunk_shift;
+	const int chunk_y = y >> level_chunk_shift;
+	const int chunk_index = chunk_y * chunk_col_count_ + chunk_x;
+	// Placed by position rather than index, so neighbours across and down never share a slot, whatever the map's width.
+	CachedChunk& cached = cache[(chunk_x & 3) | ((chunk_y & 1) << 2)];
+	const std::uint64_t insert_count = insert_count_.load(std::memory_order_relaxed);
+
+	if (cached.store_id_ != id_ || cached.chunk_index_ != chunk_index)
+	{
+		cached = { id_, chunk_index, insert_count, LoadChunk(chunk_index) };
+	}
+	else if (insert_count - cached.used_at_ > max_resident_count_ / 2)
+	{
+		// Hits here never reach the list, so a chunk in constant use is moved back up before it can be dropped.
+		TouchChunk(chunk_index, cached.chunk_);
+		cached.used_at_ = insert_count;
+	}
+
+	return *cached.chunk_;
+}
+
+int LevelChunkStore::GetColumnCount() const
+{
+	return header_.col_count_;
+}
+
+int LevelChunkStore::GetRowCount() const
+{
+	return header_.row_count_;
+}
+
+const std::vector<SDL_Color>& LevelChunkStore::GetMaterialColors() const
+{
+	return material_colors_;
+}
+
+bool LevelChunkStore::IsWall(int x, int y)
+{
+	if (x < 0 || y < 0 || x >= header_.col_count_ || y >= header_.row_count_)
+	{
+		return true;
+	}
+
+	const int index = ((y & (level_chunk_size - 1)) << level_chunk_shift) | (x & (level_chunk_size - 1));
+	return (GetChunk(x, y).wall_bits_[index >> 5] >> (index & 31)) & 1;
+}
+
+std::uint8_t LevelChunkStore::GetMaterial(int x, int y)
+{
+	if (x < 0 || y < 0 || x >= header_.col_count_ || y >= header_.row_count_)
+	{
+		return 0;
+	}
+
+	return GetChunk(x, y).materials_[((y & (level_chunk_size - 1)) << level_chunk_shift) | (x & (level_chunk_size - 1))];
+}
+
+int LevelChunkStore::GetDistance(int x, int y)
+{
+	if (x < 0 || y < 0 || x >= header_.col_count_ || y >= header_.row_count_)
+	{
+		return 0;
+	}
+
+	return GetChunk(x, y).distances_[((y & (level_chunk_size - 1)) << level_chunk_shift) | (x & (level_chunk_size - 1))];
+}
+
+std::size_t LevelChunkStore::GetResidentCount()
+{
+	const std::lock_guard<std::mutex> lock(mutex_);
+	return resident_.size();
+}
+
+std::uint64_t LevelChunkStore::GetLoadCount() const
+{
+	return load_count_;
+}
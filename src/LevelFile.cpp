@@ -0,0 +1,148 @@
+#include "LevelFile.hpp"
+#include "Constants.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+LevelFile::LevelFile() : 
+	data_(nullptr), 
+	size_(0)
+{
+}
+
+LevelFile::~LevelFile()
+{
+	Close();
+}
+
+bool LevelFile::Open(const char* path)
+{
+	Close();
+
+#if defined(__unix__) || defined(__APPLE__)
+	const int fd = open(path, O_RDONLY);
+
+	if (fd == -1)
+	{
+		printf("Unable to open level %s!\n", path);
+		return false;
+	}
+
+	struct stat status;
+
+	if (fstat(fd, &status) == 0 && status.st_size > 0)
+	{
+		void* mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+		if (mapping != MAP_FAILED)
+		{
+			data_ = static_cast<const std::uint8_t*>(mapping);
+			size_ = status.st_size;
+		}
+	}
+
+	// The mapping stays valid after its descriptor is closed.
+	close(fd);
+#else
+	std::FILE* file = std::fopen(path, "rb");
+
+	if (file == nullptr)
+	{
+		printf("Unable to open level %s!\n", path);
+		return false;
+	}
+
+	std::fseek(file, 0, SEEK_END);
+	buffer_.resize(std::max(std::ftell(file), 0L));
+	std::fseek(file, 0, SEEK_SET);
+
+	if (std::fread(buffer_.data(), 1, buffer_.size(), file) == buffer_.size())
+	{
+		data_ = buffer_.data();
+		size_ = buffer_.size();
+	}
+
+	std::fclose(file);
+#endif
+
+	if (data_ == nullptr)
+	{
+		printf("Unable to read level %s!\n", path);
+		return false;
+	}
+
+	const LevelFileHeader& header = GetHeader();
+
+	if (size_ < sizeof(LevelFileHeader) || std::memcmp(header.magic_, level_file_magic, sizeof(level_file_magic)) != 0 || header.version_ != level_file_version)
+	{
+		printf("%s is not a version %u level!\n", path, level_file_version);
+		Close();
+		return false;
+	}
+
+	// The sides are checked before anything is computed from them, and all of that is computed in 64 bits.
+	const bool sides_valid = header.col_count_ > 0 && header.row_count_ > 0 && 
+		(static_cast<std::int64_t>(header.col_count_) + 2) * (static_cast<std::int64_t>(header.row_count_) + 2) <= constants::max_padded_tile_count;
+	const std::uint64_t padded_count = sides_valid ? (static_cast<std::uint64_t>(header.col_count_) + 2) * (static_cast<std::uint64_t>(header.row_count_) + 2) : 0;
+	const std::uint64_t sections[][2] = 
+	{
+		{ header.material_colors_offset_, header.material_count_ * 4ull }, 
+		{ header.wall_bits_offset_, (padded_count + 31) / 32 * 4 }, 
+		{ header.materials_offset_, padded_count }, 
+		{ header.distances_offset_, padded_count }, 
+		{ header.pyramid_offset_, 0 }
+	};
+
+	bool valid = sides_valid && header.material_count_ > 0 && header.material_count_ <= 256 && header.file_size_ == size_;
+
+	for (const auto& section : sections)
+	{
+		valid = valid && section[0] % level_file_alignment == 0 && section[0] >= sizeof(LevelFileHeader) && section[0] <= size_ && section[1] <= size_ - section[0];
+	}
+
+	if (!valid)
+	{
+		printf("Level %s is damaged!\n", path);
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void LevelFile::Close()
+{
+#if defined(__unix__) || defined(__APPLE__)
+	if (data_ != nullptr)
+	{
+		munmap(const_cast<std::uint8_t*>(data_), size_);
+	}
+#endif
+
+	data_ = nullptr;
+	size_ = 0;
+	buffer_.clear();
+}
+
+const LevelFileHeader& LevelFile::GetHeader() const
+{
+	return *reinterpret_cast<const LevelFileHeader*>(data_);
+}
+
+const std::uint8_t* LevelFile::GetData(std::uint64_t offset) const
+{
+	return data_ + offset;
+}
+
+std::uint64_t LevelFile::GetSize() const
+{
+	return size_;
+}
@@ -0,0 +1,186 @@
+#include "Minimap.hpp"
+#include "Constants.hpp"
+#include "Game.hpp"
+#include "Level.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+	constexpr int min_zoom = 1;
+	constexpr int max_zoom = 64;
+} // namespace
+
+Minimap::Minimap(Game* game, Level* level) : 
+	game_(game), 
+	level_(level), 
+	layer_(std::make_unique<Bitmap>(nullptr, constants::screen_width, constants::screen_height)), 
+	zoom_(constants::map_scale_factor), 
+	origin_x_(0), 
+	origin_y_(0), 
+	window_width_(0), 
+	window_height_(0), 
+	stale_(true)
+{
+}
+
+void Minimap::Invalidate()
+{
+	stale_ = true;
+	dirty_tiles_.clear();
+}
+
+void Minimap::MarkTileDirty(int tile_x, int tile_y)
+{
+	// The whole window is drawn again anyway.
+	if (stale_)
+	{
+		return;
+	}
+
+	dirty_tiles_.push_back(tile_y * level_->GetColumnCount() + tile_x);
+}
+
+void Minimap::ZoomIn()
+{
+	zoom_ = std::min(zoom_ * 2, max_zoom);
+	stale_ = true;
+}
+
+void Minimap::ZoomOut()
+{
+	zoom_ = std::max(zoom_ / 2, min_zoom);
+	stale_ = true;
+}
+
+int Minimap::GetZoom()
+{
+	return zoom_;
+}
+
+int Minimap::GetWindowWidth(int view_width)
+{
+	const int map_width = level_->GetColumnCount() * zoom_;
+	return map_width <= view_width ? map_width : view_width / constants::map_view_divisor;
+}
+
+int Minimap::GetWindowHeight(int view_height)
+{
+	const int map_height = level_->GetRowCount() * zoom_;
+	return map_height <= view_height ? map_height : view_height / constants::map_view_divisor;
+}
+
+void Minimap::Draw(Bitmap& target, const Vect2d<float>& focus)
+{
+	const int window_width = GetWindowWidth(target.GetViewWidth());
+	const int window_height = GetWindowHeight(target.GetViewHeight());
+	// Tiles the window spans, the last ones possibly only in part.
+	const int window_cols = (window_width + zoom_ - 1) / zoom_;
+	const int window_rows = (window_height + zoom_ - 1) / zoom_;
+	// Centred on the focus as far as the level's edges allow. The origin moves in whole tiles, so 
+	// scrolling keeps most of the layer and only draws the tiles that come into view.
+	const int origin_x = std::clamp(static_cast<int>(focus.x_) - window_cols / 2, 0, level_->GetColumnCount() - window_cols);
+	const int origin_y = std::clamp(static_cast<int>(focus.y_) - window_rows / 2, 0, level_->GetRowCount() - window_rows);
+
+	if (window_width != window_width_ || window_height != window_height_)
+	{
+		stale_ = true;
+	}
+
+	// Only the tiles that were wholly in the last window are kept; the ones cut off at its edges are drawn again.
+	SDL_Rect kept = { origin_x_, origin_y_, window_width_ / zoom_, window_height_ / zoom_ };
+
+	if (stale_)
+	{
+		kept = { 0, 0, 0, 0 };
+	}
+	else if (origin_x != origin_x_ || origin_y != origin_y_)
+	{
+		ScrollLayer(origin_x - origin_x_, origin_y - origin_y_);
+	}
+
+	origin_x_ = origin_x;
+	origin_y_ = origin_y;
+	window_width_ = window_width;
+	window_height_ = window_height;
+	layer_->SetViewport(window_width_, window_height_);
+
+	DrawTiles(kept);
+
+	for (int index : dirty_tiles_)
+	{
+		DrawTile(index % level_->GetColumnCount(), index / level_->GetColumnCount());
+	}
+
+	stale_ = false;
+	dirty_tiles_.clear();
+
+	target.DrawBitmap(*layer_, 0, 0);
+}
+
+Vect2d<float> Minimap::GetScreenPosition(const Vect2d<float>& point)
+{
+	return { (point.x_ - origin_x_) * zoom_, (point.y_ - origin_y_) * zoom_ };
+}
+
+void Minimap::DrawTile(int tile_x, int tile_y)
+{
+	if (tile_x < 0 || tile_y < 0 || tile_x >= level_->GetColumnCount() || tile_y >= level_->GetRowCount())
+	{
+		return;
+	}
+
+	// Tiles outside the window fall entirely outside the layer's view and are clipped away.
+	const int x = (tile_x - origin_x_) * zoom_;
+	const int y = (tile_y - origin_y_) * zoom_;
+	layer_->DrawFillRect(x, y, x + zoom_, y + zoom_, game_->GetColor(level_->GetMaterialColor(level_->GetMaterial(tile_x, tile_y))));
+}
+
+void Minimap::DrawTiles(const SDL_Rect& kept)
+{
+	const int end_x = origin_x_ + (window_width_ + zoom_ - 1) / zoom_;
+	const int end_y = origin_y_ + (window_height_ + zoom_ - 1) / zoom_;
+
+	for (int y = origin_y_; y < end_y; ++y)
+	{
+		const bool row_kept = y >= kept.y && y < kept.y + kept.h;
+
+		for (int x = origin_x_; x < end_x; ++x)
+		{
+			if (row_kept && x >= kept.x && x < kept.x + kept.w)
+			{
+				continue;
+			}
+
+			DrawTile(x, y);
+		}
+	}
+}
+
+void Minimap::ScrollLayer(int delta_x, int delta_y)
+{
+	const int shift_x = delta_x * zoom_;
+	const int shift_y = delta_y * zoom_;
+	const int width = window_width_ - std::abs(shift_x);
+	const int height = window_height_ - std::abs(shift_y);
+
+	if (width <= 0 || height <= 0)
+	{
+		return;
+	}
+
+	std::uint32_t* pixels = layer_->pixels_;
+	const std::size_t pitch = layer_->pitch_;
+	const int src_x = std::max(shift_x, 0);
+	const int dst_x = std::max(-shift_x, 0);
+
+	// Rows go in the order that reads every row before it is overwritten.
+	for (int i = 0; i < height; ++i)
+	{
+		const int y = shift_y >= 0 ? i : height - 1 - i;
+		std::memmove(pixels + (y + std::max(-shift_y, 0)) * pitch + dst_x, pixels + (y + std::max(shift_y, 0)) * pitch + src_x, width * sizeof(std::uint32_t));
+	}
+}
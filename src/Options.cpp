@@ -0,0 +1,89 @@
+#include "Options.hpp"
+#include "Constants.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <thread>
+
+Options ParseOptions(int argc, char* argv[])
+{
+	Options options;
+	options.thread_count_ = std::thread::hardware_concurrency();
+	options.level_path_ = "res/gfx/level.png";
+	options.benchmark_ticks_ = 0;
+	options.target_frame_ms_ = 1000.0 / 60.0;
+	options.maze_col_count_ = 29;
+	options.maze_row_count_ = 27;
+	options.maze_seed_ = static_cast<std::uint32_t>(std::time(nullptr));
+	options.maze_chunk_size_ = 0;
+	options.generate_maze_ = false;
+	options.convert_path_ = nullptr;
+	options.chunk_memory_budget_ = std::size_t(256) << 20;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if ((std::strcmp(argv[i], "-t") == 0 || std::strcmp(argv[i], "--threads") == 0) && i + 1 < argc)
+		{
+			options.thread_count_ = std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if ((std::strcmp(argv[i], "-l") == 0 || std::strcmp(argv[i], "--level") == 0) && i + 1 < argc)
+		{
+			options.level_path_ = argv[++i];
+		}
+		else if ((std::strcmp(argv[i], "-b") == 0 || std::strcmp(argv[i], "--benchmark") == 0) && i + 1 < argc)
+		{
+			options.benchmark_ticks_ = std::max(0, std::atoi(argv[++i]));
+		}
+		else if ((std::strcmp(argv[i], "-f") == 0 || std::strcmp(argv[i], "--frame-budget") == 0) && i + 1 < argc)
+		{
+			options.target_frame_ms_ = std::max(0.1, std::atof(argv[++i]));
+		}
+		else if ((std::strcmp(argv[i], "-m") == 0 || std::strcmp(argv[i], "--maze") == 0) && i + 1 < argc)
+		{
+			if (std::sscanf(argv[++i], "%dx%d", &options.maze_col_count_, &options.maze_row_count_) != 2)
+			{
+				printf("Maze size %s is not of the form WIDTHxHEIGHT!\n", argv[i]);
+			}
+			else if (options.maze_col_count_ > constants::max_maze_side || options.maze_row_count_ > constants::max_maze_side)
+			{
+				options.maze_col_count_ = std::min(options.maze_col_count_, constants::max_maze_side);
+				options.maze_row_count_ = std::min(options.maze_row_count_, constants::max_maze_side);
+				printf("Mazes are at most %dx%d tiles, generating %dx%d!\n", constants::max_maze_side, constants::max_maze_side, options.maze_col_count_, options.maze_row_count_);
+			}
+		}
+		else if ((std::strcmp(argv[i], "-s") == 0 || std::strcmp(argv[i], "--seed") == 0) && i + 1 < argc)
+		{
+			options.maze_seed_ = std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if ((std::strcmp(argv[i], "-c") == 0 || std::strcmp(argv[i], "--maze-chunk") == 0) && i + 1 < argc)
+		{
+			options.maze_chunk_size_ = std::max(0, std::atoi(argv[++i]));
+		}
+		else if ((std::strcmp(argv[i], "-o") == 0 || std::strcmp(argv[i], "--convert") == 0) && i + 1 < argc)
+		{
+			options.convert_path_ = argv[++i];
+		}
+		else if ((std::strcmp(argv[i], "-r") == 0 || std::strcmp(argv[i], "--chunk-budget") == 0) && i + 1 < argc)
+		{
+			options.chunk_memory_budget_ = static_cast<std::size_t>(std::max(1, std::atoi(argv[++i]))) << 20;
+		}
+		else if (std::strcmp(argv[i], "-g") == 0 || std::strcmp(argv[i], "--generate") == 0)
+		{
+			options.generate_maze_ = true;
+		}
+		else
+		{
+			printf("Unknown option %s!\n", argv[i]);
+		}
+	}
+
+	if (options.thread_count_ == 0)
+	{
+		options.thread_count_ = 1;
+	}
+
+	return options;
+}
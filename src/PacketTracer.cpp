@@ -0,0 +1,260 @@
+#include "PacketTracer.hpp"
+#include "Level.hpp"
+
+#include <bitset>
+#include <cassert>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+#if defined(__AVX2__)
+	struct Lanes
+	{
+		using Float = __m256;
+		using Int = __m256i;
+
+		static Float LoadFloat(const float* p) { return _mm256_load_ps(p); }
+		static void StoreFloat(float* p, Float v) { _mm256_store_ps(p, v); }
+		static Int LoadInt(const std::int32_t* p) { return _mm256_load_si256(reinterpret_cast<const __m256i*>(p)); }
+		static void StoreInt(std::int32_t* p, Int v) { _mm256_store_si256(reinterpret_cast<__m256i*>(p), v); }
+		static Int SetInt(std::int32_t v) { return _mm256_set1_epi32(v); }
+		static Int LessThan(Float a, Float b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+		static Float AddMasked(Float a, Float b, Int mask) { return _mm256_add_ps(a, _mm256_and_ps(b, _mm256_castsi256_ps(mask))); }
+		static Int AddMasked(Int a, Int b, Int mask) { return _mm256_add_epi32(a, _mm256_and_si256(b, mask)); }
+		static Int And(Int a, Int b) { return _mm256_and_si256(a, b); }
+		static Int AndNot(Int a, Int b) { return _mm256_andnot_si256(a, b); }
+		static Int Or(Int a, Int b) { return _mm256_or_si256(a, b); }
+		static Int Equal(Int a, Int b) { return _mm256_cmpeq_epi32(a, b); }
+		static int MoveMask(Int mask) { return _mm256_movemask_ps(_mm256_castsi256_ps(mask)); }
+
+		// Gathers the occupancy word of every lane's cell and tests its bit, all in registers.
+		static Int TestWalls(const std::uint32_t* wall_bits, Int padded_col_count, Int map_x, Int map_y)
+		{
+			const Int one = _mm256_set1_epi32(1);
+			const Int index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(map_y, one), padded_col_count), _mm256_add_epi32(map_x, one));
+			const Int words = _mm256_i32gather_epi32(reinterpret_cast<const int*>(wall_bits), _mm256_srli_epi32(index, 5), 4);
+			const Int bits = _mm256_and_si256(_mm256_srlv_epi32(words, _mm256_and_si256(index, _mm256_set1_epi32(31))), one);
+			return _mm256_cmpeq_epi32(bits, one);
+		}
+	};
+#elif defined(__SSE2__)
+	struct Lanes
+	{
+		using Float = __m128;
+		using Int = __m128i;
+
+		static Float LoadFloat(const float* p) { return _mm_load_ps(p); }
+		static void StoreFloat(float* p, Float v) { _mm_store_ps(p, v); }
+		static Int LoadInt(const std::int32_t* p) { return _mm_load_si128(reinterpret_cast<const __m128i*>(p)); }
+		static void StoreInt(std::int32_t* p, Int v) { _mm_store_si128(reinterpret_cast<__m128i*>(p), v); }
+		static Int SetInt(std::int32_t v) { return _mm_set1_epi32(v); }
+		static Int LessThan(Float a, Float b) { return _mm_castps_si128(_mm_cmplt_ps(a, b)); }
+		static Float AddMasked(Float a, Float b, Int mask) { return _mm_add_ps(a, _mm_and_ps(b, _mm_castsi128_ps(mask))); }
+		static Int AddMasked(Int a, Int b, Int mask) { return _mm_add_epi32(a, _mm_and_si128(b, mask)); }
+		static Int And(Int a, Int b) { return _mm_and_si128(a, b); }
+		static Int AndNot(Int a, Int b) { return _mm_andnot_si128(a, b); }
+		static Int Or(Int a, Int b) { return _mm_or_si128(a, b); }
+		static Int Equal(Int a, Int b) { return _mm_cmpeq_epi32(a, b); }
+		static int MoveMask(Int mask) { return _mm_movemask_ps(_mm_castsi128_ps(mask)); }
+	};
+#endif
+} // namespace
+
+PacketTracer::PacketTracer(Level* level) : 
+	level_(level)
+{
+}
+
+bool PacketTracer::IsWall(int x, int y)
+{
+	return level_->IsWall(x, y);
+}
+
+void PacketTracer::TracePacket(const Vect2d<float>& origin, const float* ray_dirs_x, const float* ray_dirs_y, int count, const TraceSettings& settings, RayHit* hits)
+{
+	assert(count > 0 && count <= lane_count);
+
+	Packet packet = {};
+	int active_mask = 0;
+
+	const int origin_x = static_cast<int>(origin.x_);
+	const int origin_y = static_cast<int>(origin.y_);
+
+	// Same set-up as Player::DigitalDifferentialAnalysis, in single precision.
+	for (int lane = 0; lane < count; ++lane)
+	{
+		const float ray_dir_x = ray_dirs_x[lane];
+		const float ray_dir_y = ray_dirs_y[lane];
+
+		packet.ray_step_size_x_[lane] = std::abs(1 / ray_dir_x);
+		packet.ray_step_size_y_[lane] = std::abs(1 / ray_dir_y);
+
+		if (ray_dir_x < 0)
+		{
+			packet.step_x_[lane] = -1;
+			packet.ray_length_x_[lane] = (origin.x_ - origin_x) * packet.ray_step_size_x_[lane];
+		}
+		else
+		{
+			packet.step_x_[lane] = 1;
+			packet.ray_length_x_[lane] = (origin_x + 1 - origin.x_) * packet.ray_step_size_x_[lane];
+		}
+
+		if (ray_dir_y < 0)
+		{
+			packet.step_y_[lane] = -1;
+			packet.ray_length_y_[lane] = (origin.y_ - origin_y) * packet.ray_step_size_y_[lane];
+		}
+		else
+		{
+			packet.step_y_[lane] = 1;
+			packet.ray_length_y_[lane] = (origin_y + 1 - origin.y_) * packet.ray_step_size_y_[lane];
+		}
+
+		packet.map_x_[lane] = origin_x;
+		packet.map_y_[lane] = origin_y;
+		packet.wall_side_[lane] = -1;
+		packet.active_[lane] = -1;
+		active_mask |= 1 << lane;
+	}
+
+	// The skipping structures make every lane jump a different distance, so those modes trace lane by lane.
+	if (!settings.skipping_ && !settings.hierarchical_)
+	{
+		MarchPacket(packet, active_mask);
+	}
+
+	for (int lane = 0; lane < count; ++lane)
+	{
+		if ((active_mask & (1 << lane)) != 0)
+		{
+			FinishLane(packet, lane, settings);
+		}
+
+		assert(packet.wall_side_[lane] != -1);
+
+		hits[lane].map_x_ = packet.map_x_[lane];
+		hits[lane].map_y_ = packet.map_y_[lane];
+		hits[lane].wall_side_ = packet.wall_side_[lane];
+		hits[lane].steps_ = packet.steps_[lane];
+		hits[lane].distance_ = packet.wall_side_[lane] == 0 ? 
+			packet.ray_length_x_[lane] - packet.ray_step_size_x_[lane] : 
+			packet.ray_length_y_[lane] - packet.ray_step_size_y_[lane];
+	}
+}
+
+void PacketTracer::MarchPacket(Packet& packet, int& active_mask)
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+	Lanes::Float ray_length_x = Lanes::LoadFloat(packet.ray_length_x_);
+	Lanes::Float ray_length_y = Lanes::LoadFloat(packet.ray_length_y_);
+	const Lanes::Float ray_step_size_x = Lanes::LoadFloat(packet.ray_step_size_x_);
+	const Lanes::Float ray_step_size_y = Lanes::LoadFloat(packet.ray_step_size_y_);
+	const Lanes::Int step_x = Lanes::LoadInt(packet.step_x_);
+	const Lanes::Int step_y = Lanes::LoadInt(packet.step_y_);
+	Lanes::Int map_x = Lanes::LoadInt(packet.map_x_);
+	Lanes::Int map_y = Lanes::LoadInt(packet.map_y_);
+	Lanes::Int wall_side = Lanes::LoadInt(packet.wall_side_);
+	Lanes::Int steps = Lanes::LoadInt(packet.steps_);
+	Lanes::Int active = Lanes::LoadInt(packet.active_);
+	const Lanes::Int one = Lanes::SetInt(1);
+	const Lanes::Int guard = Lanes::SetInt(level_->GetMaxRaySteps());
+#if defined(__AVX2__)
+	const Lanes::Int padded_col_count = Lanes::SetInt(level_->GetPaddedColumnCount());
+#endif
+
+	while (std::bitset<lane_count>(active_mask).count() > straggler_count)
+	{
+		// Every marching lane takes exactly one step; the compare picks the axis per lane instead of branching.
+		const Lanes::Int x_mask = Lanes::And(Lanes::LessThan(ray_length_x, ray_length_y), active);
+		const Lanes::Int y_mask = Lanes::AndNot(x_mask, active);
+
+		ray_length_x = Lanes::AddMasked(ray_length_x, ray_step_size_x, x_mask);
+		ray_length_y = Lanes::AddMasked(ray_length_y, ray_step_size_y, y_mask);
+		map_x = Lanes::AddMasked(map_x, step_x, x_mask);
+		map_y = Lanes::AddMasked(map_y, step_y, y_mask);
+		wall_side = Lanes::Or(Lanes::AndNot(active, wall_side), Lanes::And(y_mask, one));
+		steps = Lanes::AddMasked(steps, one, active);
+
+#if defined(__AVX2__)
+		const Lanes::Int walls = Lanes::TestWalls(level_->GetWallBits(), padded_col_count, map_x, map_y);
+#else
+		alignas(32) std::int32_t wall_lanes[lane_count];
+		Lanes::StoreInt(packet.map_x_, map_x);
+		Lanes::StoreInt(packet.map_y_, map_y);
+
+		for (int lane = 0; lane < lane_count; ++lane)
+		{
+			wall_lanes[lane] = IsWall(packet.map_x_[lane], packet.map_y_[lane]) ? -1 : 0;
+		}
+
+		const Lanes::Int walls = Lanes::LoadInt(wall_lanes);
+#endif
+		const Lanes::Int guarded = Lanes::And(Lanes::Equal(steps, guard), active);
+
+		if (Lanes::MoveMask(guarded) != 0)
+		{
+			assert(false);
+		}
+
+		active = Lanes::AndNot(Lanes::Or(walls, guarded), active);
+		active_mask = Lanes::MoveMask(active);
+	}
+
+	Lanes::StoreInt(packet.map_x_, map_x);
+	Lanes::StoreInt(packet.map_y_, map_y);
+	Lanes::StoreInt(packet.steps_, steps);
+
+	Lanes::StoreFloat(packet.ray_length_x_, ray_length_x);
+	Lanes::StoreFloat(packet.ray_length_y_, ray_length_y);
+	Lanes::StoreInt(packet.wall_side_, wall_side);
+#else
+	(void) packet;
+	(void) active_mask;
+#endif
+}
+
+void PacketTracer::FinishLane(Packet& packet, int lane, const TraceSettings& settings)
+{
+	const int max_steps = level_->GetMaxRaySteps();
+	bool wall_hit = false;
+
+	while (!wall_hit)
+	{
+		if (++packet.steps_[lane] == max_steps)
+		{
+			assert(false);
+			break;
+		}
+
+		int reach_x = 0;
+		int reach_y = 0;
+
+		if (level_->GetEmptyReach(packet.map_x_[lane], packet.map_y_[lane], packet.step_x_[lane], packet.step_y_[lane], settings.skipping_, settings.hierarchical_, reach_x, reach_y))
+		{
+			SkipCrossings(reach_x, reach_y, packet.ray_step_size_x_[lane], packet.ray_step_size_y_[lane], packet.step_x_[lane], packet.step_y_[lane], 
+				packet.ray_length_x_[lane], packet.ray_length_y_[lane], packet.map_x_[lane], packet.map_y_[lane]);
+		}
+
+		if (packet.ray_length_x_[lane] < packet.ray_length_y_[lane])
+		{
+			packet.ray_length_x_[lane] += packet.ray_step_size_x_[lane];
+			packet.map_x_[lane] += packet.step_x_[lane];
+			packet.wall_side_[lane] = 0;
+		}
+		else
+		{
+			packet.ray_length_y_[lane] += packet.ray_step_size_y_[lane];
+			packet.map_y_[lane] += packet.step_y_[lane];
+			packet.wall_side_[lane] = 1;
+		}
+
+		wall_hit = IsWall(packet.map_x_[lane], packet.map_y_[lane]);
+	}
+}
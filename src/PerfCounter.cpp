@@ -0,0 +1,72 @@
+#include "PerfCounter.hpp"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#endif
+
+CacheMissCounter::CacheMissCounter() : 
+	fd_(-1)
+{
+#if defined(__linux__)
+	perf_event_attr attr;
+	std::memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	fd_ = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+}
+
+CacheMissCounter::~CacheMissCounter()
+{
+#if defined(__linux__)
+	if (fd_ != -1)
+	{
+		close(fd_);
+	}
+#endif
+}
+
+bool CacheMissCounter::IsAvailable() const
+{
+	return fd_ != -1;
+}
+
+void CacheMissCounter::Start()
+{
+#if defined(__linux__)
+	if (fd_ != -1)
+	{
+		ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+}
+
+std::uint64_t CacheMissCounter::Stop()
+{
+	std::uint64_t count = 0;
+
+#if defined(__linux__)
+	if (fd_ != -1)
+	{
+		ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+
+		if (read(fd_, &count, sizeof(count)) != sizeof(count))
+		{
+			count = 0;
+		}
+	}
+#endif
+
+	return count;
+}
@@ -2,11 +2,15 @@
 #include "Level.hpp"
 #include "Game.hpp"
 #include "Constants.hpp"
+#include "FloorSpan.hpp"
+#include "Minimap.hpp"
+#include "WallSpan.hpp"
 
 #include <SDL2/SDL.h>
 
 #include <iostream>
 #include <cassert>
+#include <cmath>
 
 Player::Player(Game* game, Screen* screen, Level* level) : 
 	game_(game), 
@@ -21,7 +25,22 @@ Player::Player(Game* game, Screen* screen, Level* level) :
 	rotating_degrees_(0.0f), 
 	rotating_(false), 
 	moving_forwards_(false), 
-	moving_backwards_(false)
+	moving_backwards_(false), 
+	camera_(constants::screen_width), 
+	packet_tracer_(level), 
+	ray_scratch_(game->thread_pool_->GetThreadCount(), RayScratch{ 0, 0, 0, 0, 0, 0, 0 }), 
+	wall_tops_(constants::screen_width, 0), 
+	wall_bottoms_(constants::screen_width, 0), 
+	view_width_(constants::screen_width), 
+	view_height_(constants::screen_height), 
+	hits_(constants::screen_width), 
+	previous_hits_(constants::screen_width), 
+	edge_coverage_(constants::screen_width + 1, 0), 
+	cached_view_(), 
+	cache_valid_(false), 
+	reuse_frame_(false), 
+	seed_from_cache_(false), 
+	seed_translation_(0.0)
 {
 }
 
@@ -74,6 +93,11 @@ void Player::HandleEvent(SDL_Event* e)
 				plane_.SetLength(plane_len - 0.1);
 			}
 		}
+		else if (e->key.keysym.sym == SDLK_x)
+		{
+			// Knocks out the wall tile straight ahead.
+			level_->DeleteWall(static_cast<int>(std::floor(position_.x_ + direction_.x_)), static_cast<int>(std::floor(position_.y_ + direction_.y_)));
+		}
 	}
 
 	if (e->type == SDL_KEYUP)
@@ -131,33 +155,88 @@ void Player::Tick()
 
 	if (moving_forwards_ || moving_backwards_)
 	{
-		const Tile* next_tile = level_->GetTile(position_.x_ + velocity_.x_, position_.y_ + velocity_.y_);
+		// Steps are shorter than a tile, so they end at most on the solid border IsWall() covers.
+		const int next_x = static_cast<int>(std::floor(position_.x_ + velocity_.x_));
+		const int next_y = static_cast<int>(std::floor(position_.y_ + velocity_.y_));
 
-		if (next_tile != nullptr && !next_tile->is_wall_)
+		if (!level_->IsWall(next_x, next_y))
 		{
 			position_.x_ += velocity_.x_;
 			position_.y_ += velocity_.y_;
 		}
 	}
 
-	if (game_->map_toggled_)
+	// The map of a reused frame is already in it.
+	if (game_->map_toggled_ && !reuse_frame_)
 	{
-		level_->Tick();
-		const int scale_factor = 16;
+		level_->Tick(position_);
+		Minimap& minimap = level_->GetMinimap();
 		const std::uint32_t lines_color = game_->GetColor({ 0xff, 0xff, 0xff, 0xff });
-		screen_->bitmap_->DrawLine(position_.x_ * scale_factor, position_.y_ * scale_factor, (position_.x_ + direction_.x_ + plane_.x_) * scale_factor, (position_.y_ + direction_.y_ + plane_.y_) * scale_factor, lines_color);
-		screen_->bitmap_->DrawLine(position_.x_ * scale_factor, position_.y_ * scale_factor, (position_.x_ + direction_.x_ - plane_.x_) * scale_factor, (position_.y_ + direction_.y_ - plane_.y_) * scale_factor, lines_color);
+		const Vect2d<float> eye = minimap.GetScreenPosition(position_);
+		const Vect2d<float> left = minimap.GetScreenPosition({ position_.x_ + direction_.x_ + plane_.x_, position_.y_ + direction_.y_ + plane_.y_ });
+		const Vect2d<float> right = minimap.GetScreenPosition({ position_.x_ + direction_.x_ - plane_.x_, position_.y_ + direction_.y_ - plane_.y_ });
+		screen_->bitmap_->DrawLine(eye.x_, eye.y_, left.x_, left.y_, lines_color);
+		screen_->bitmap_->DrawLine(eye.x_, eye.y_, right.x_, right.y_, lines_color);
 	}
 }
 
+bool Player::PrepareFrame()
+{
+	const CachedView view = GetCurrentView();
+
+	reuse_frame_ = false;
+	seed_from_cache_ = false;
+
+	const bool same_settings = cache_valid_ && view.view_width_ == cached_view_.view_width_ && view.view_height_ == cached_view_.view_height_ && 
+		view.level_generation_ == cached_view_.level_generation_ && view.settings_ == cached_view_.settings_;
+	const bool same_heading = view.direction_.x_ == cached_view_.direction_.x_ && view.direction_.y_ == cached_view_.direction_.y_ && 
+		view.plane_.x_ == cached_view_.plane_.x_ && view.plane_.y_ == cached_view_.plane_.y_;
+
+	if (game_->temporal_cache_toggled_ && same_settings && same_heading)
+	{
+		const double move_x = view.position_.x_ - cached_view_.position_.x_;
+		const double move_y = view.position_.y_ - cached_view_.position_.y_;
+		seed_translation_ = std::sqrt(move_x * move_x + move_y * move_y);
+
+		reuse_frame_ = seed_translation_ == 0.0;
+		// Only the scalar tracer seeds; the packet and adaptive ones trace their columns in groups.
+		seed_from_cache_ = !reuse_frame_ && seed_translation_ <= constants::temporal_max_translation && !game_->packets_toggled_ && !game_->adaptive_toggled_;
+	}
+
+	cached_view_ = view;
+
+	return reuse_frame_;
+}
+
+CachedView Player::GetCurrentView()
+{
+	// Everything besides the camera that changes what the ray pass leaves in the frame.
+	const bool settings[] = 
+	{ 
+		game_->map_toggled_, game_->fisheye_effect_toggled_, game_->textures_toggled_, game_->packets_toggled_, game_->mipmaps_toggled_, 
+		game_->fog_toggled_, game_->floor_toggled_, game_->adaptive_toggled_, screen_->bitmap_->IsColumnMajor() 
+	};
+
+	std::uint32_t settings_bits = 0;
+
+	for (std::size_t i = 0; i < std::size(settings); ++i)
+	{
+		settings_bits |= static_cast<std::uint32_t>(settings[i]) << i;
+	}
+
+	// The minimap's zoom goes above the flags.
+	settings_bits |= static_cast<std::uint32_t>(level_->GetMinimap().GetZoom()) << std::size(settings);
+
+	return { position_, direction_, plane_, screen_->bitmap_->GetViewWidth(), screen_->bitmap_->GetViewHeight(), level_->GetGeneration(), settings_bits };
+}
+
 Vect2d<float> Player::RotatePoint(const Vect2d<float>& rotating_point, const Vect2d<float>& pivot, int degrees)
 {
 	Vect2d<float> result_point = { rotating_point.x_, rotating_point.y_ };
 
-	const double pi = std::acos(-1);
-	const double deg_to_rad = static_cast<double>(degrees) * pi / 180.0;
-	const double sin_degrees = std::sin(deg_to_rad);
-	const double cos_degrees = std::cos(deg_to_rad);
+	double cos_degrees = 0.0;
+	double sin_degrees = 0.0;
+	camera_.GetRotation(degrees, cos_degrees, sin_degrees);
 
 	const double new_x = (result_point.x_ - pivot.x_) * cos_degrees - (result_point.y_ - pivot.y_) * sin_degrees;
 	const double new_y = (result_point.x_ - pivot.x_) * sin_degrees + (result_point.y_ - pivot.y_) * cos_degrees;
@@ -170,76 +249,664 @@ Vect2d<float> Player::RotatePoint(const Vect2d<float>& rotating_point, const Vec
 
 void Player::CastRayLines()
 {
-	// for (int y2 = constants::screen_height / 2 + 1; y2 < constants::screen_height; ++y2)
-	// {
-	// 	float ray_dir_x0 = direction_.x_ - plane_.x_;
-	// 	float ray_dir_y0 = direction_.y_ - plane_.y_;
-	// 	float ray_dir_x1 = direction_.x_ + plane_.x_;
-	// 	float ray_dir_y1 = direction_.y_ + plane_.y_;
+	view_width_ = screen_->bitmap_->GetViewWidth();
+	view_height_ = screen_->bitmap_->GetViewHeight();
+	camera_.Update(view_width_, direction_, plane_);
+
+	if (reuse_frame_)
+	{
+		// Nothing the frame depends on has changed, so the last one is still in the bitmap as it is.
+		++ray_scratch_[0].frames_reused_;
+		return;
+	}
 
-	// 	int p = y2 - constants::screen_height / 2;
-	// 	float pos_z = 0.5f * constants::screen_height;
-	// 	float row_distance = pos_z / p;
+	// The old way, kept for debugging: clear the whole view up front and draw every pass over it. The column-major 
+	// target is filled completely by the wall pass and then transposed over the whole frame either way.
+	if (game_->full_clear_toggled_ && !screen_->bitmap_->IsColumnMajor())
+	{
+		screen_->bitmap_->Clear();
+		ray_scratch_[0].pixels_cleared_ += static_cast<std::uint64_t>(view_width_) * view_height_;
+	}
 
-	// 	float floor_step_x = row_distance * (ray_dir_x1 - ray_dir_x0) / constants::screen_width;
-	// 	float floor_step_y = row_distance * (ray_dir_y1 - ray_dir_y0) / constants::screen_width;
+	if (seed_from_cache_)
+	{
+		FindSeedableColumns();
+	}
 
-	// 	float floor_x = position_.x_ + row_distance * ray_dir_x0;
-	// 	float floor_y = position_.y_ + row_distance * ray_dir_y0;
+	if (game_->parallel_toggled_)
+	{
+		// Each worker owns whole column bands, so the writes into the bitmap never overlap.
+		game_->thread_pool_->ParallelFor(0, view_width_, constants::column_band_width, [this](int band_begin, int band_end, std::size_t worker_index)
+		{
+			CastRayBand(band_begin, band_end, ray_scratch_[worker_index]);
+		});
+	}
+	else
+	{
+		CastRayBand(0, view_width_, ray_scratch_[0]);
+	}
 
+	hits_.swap(previous_hits_);
+	cache_valid_ = true;
+
+	const bool clear_rows = !game_->floor_toggled_ && !game_->full_clear_toggled_ && !screen_->bitmap_->IsColumnMajor();
+
+	if (!game_->floor_toggled_ && !clear_rows)
+	{
+		return;
+	}
+
+	// The floor pass runs after every wall column is in place, so it can fill just the pixels around them; 
+	// without a floor, the same pixels are cleared instead.
+	const auto draw_rows = [this, clear_rows](int band_begin, int band_end, RayScratch& scratch)
+	{
+		if (clear_rows)
+		{
+			ClearFloorRows(band_begin, band_end, scratch);
+		}
+		else
+		{
+			CastFloorRows(band_begin, band_end, scratch);
+		}
+	};
 
-	// 	for (int x2 = 0; x2 < constants::screen_width; ++x2)
-	// 	{
-	// 		int cell_x = static_cast<int>(floor_x);
-	// 		int cell_y = static_cast<int>(floor_y);
+	if (game_->parallel_toggled_)
+	{
+		game_->thread_pool_->ParallelFor(0, view_height_, constants::row_band_height, [this, &draw_rows](int band_begin, int band_end, std::size_t worker_index)
+		{
+			draw_rows(band_begin, band_end, ray_scratch_[worker_index]);
+		});
+	}
+	else
+	{
+		draw_rows(0, view_height_, ray_scratch_[0]);
+	}
+}
 
-	// 		int tx = static_cast<int>(64 * (floor_x - cell_x)) & (64 - 1);
-	// 		int ty = static_cast<int>(64 * (floor_y - cell_y)) & (64 - 1);
+void Player::ClearFloorRows(int begin_y, int end_y, RayScratch& scratch)
+{
+	Bitmap* bitmap = screen_->bitmap_.get();
+	const std::uint32_t clear_color = bitmap->GetClearColor();
 
-	// 		floor_x += floor_step_x;
-	// 		floor_y += floor_step_y;
+	for (int y = begin_y; y < end_y; ++y)
+	{
+		scratch.pixels_cleared_ += ClearFloorSpan(clear_color, y, wall_tops_.data(), wall_bottoms_.data(), bitmap->pixels_ + y * bitmap->pitch_, GetMapCoverWidth(y), view_width_);
+	}
+}
 
-	// 		// Floor
-	// 		std::uint32_t* floor_pixels = game_->textures_[4]->GetPixels32();
+int Player::GetMapCoverWidth(int y)
+{
+	// The minimap is drawn over the top-left corner of the frame afterwards, so nothing under it needs drawing.
+	if (!game_->map_toggled_ || y >= level_->GetMinimap().GetWindowHeight(view_height_))
+	{
+		return 0;
+	}
 
-	// 		std::uint32_t color = floor_pixels[ty * 64 + tx];
-	// 		color = (color >> 1) & 8355711;
-	// 		screen_->bitmap_->DrawPoint(x2, y2, color);
+	return level_->GetMinimap().GetWindowWidth(view_width_);
+}
 
-	// 		// Ceiling
-	// 		std::uint32_t* ceiling_pixels = game_->textures_[5]->GetPixels32();
-	// 		color = ceiling_pixels[ty * 64 + tx];
-	// 		color = (color >> 1) & 8355711;
-	// 		screen_->bitmap_->DrawPoint(x2, constants::screen_height - y2 - 1, color);
-			
-	// 	}	
-	// }
+void Player::CastFloorRows(int begin_y, int end_y, RayScratch& scratch)
+{
+	const int horizon = view_height_ / 2 + GetViewPitch();
+	const double camera_height = 0.5 * view_height_;
+	const Vect2d<double> ray_dir_left = { direction_.x_ - plane_.x_, direction_.y_ - plane_.y_ };
+	const Vect2d<double> ray_dir_right = { direction_.x_ + plane_.x_, direction_.y_ + plane_.y_ };
+	Bitmap* bitmap = screen_->bitmap_.get();
 
-	for (int x = 0; x < constants::screen_width; ++x)
+	for (int y = begin_y; y < end_y; ++y)
 	{
-		const double camera_x = ((2 * x) / static_cast<double>(constants::screen_width)) - 1;
-		const double ray_dir_x = direction_.x_ + plane_.x_ * camera_x;
-		const double ray_dir_y = direction_.y_ + plane_.y_ * camera_x;
+		if (y == horizon)
+		{
+			// The floor and ceiling meet infinitely far away, so this row only has the clear color around the walls.
+			if (!game_->full_clear_toggled_)
+			{
+				scratch.pixels_cleared_ += ClearFloorSpan(bitmap->GetClearColor(), y, wall_tops_.data(), wall_bottoms_.data(), bitmap->pixels_ + y * bitmap->pitch_, GetMapCoverWidth(y), view_width_);
+			}
+
+			continue;
+		}
+
+		const bool ceiling = y < horizon;
+		const Texture* texture = game_->textures_[ceiling ? 4 : 5].get();
+
+		// Every pixel of a row sees the floor at the same distance, so the row is one straight line 
+		// through texture space: a start point and a per-pixel step, computed once here.
+		const double row_distance = camera_height / (ceiling ? horizon - y : y - horizon);
+		const double step_x = row_distance * (ray_dir_right.x_ - ray_dir_left.x_) / view_width_;
+		const double step_y = row_distance * (ray_dir_right.y_ - ray_dir_left.y_) / view_width_;
+		const double floor_x = position_.x_ + row_distance * ray_dir_left.x_;
+		const double floor_y = position_.y_ + row_distance * ray_dir_left.y_;
 
-		DigitalDifferentialAnalysis(x, { ray_dir_x, ray_dir_y });
+		int mip_level = 0;
+
+		if (game_->mipmaps_toggled_)
+		{
+			const double texel_step = std::max(std::abs(step_x), std::abs(step_y)) * texture->width_;
+
+			while (texel_step >= 2.0 * (1 << mip_level) && mip_level + 1 < texture->GetMipCount())
+			{
+				++mip_level;
+			}
+		}
+
+		const int fog_level = GetFogLevel(row_distance);
+		const int texture_width = static_cast<int>(texture->GetMipWidth(mip_level));
+		const int texture_height = static_cast<int>(texture->GetMipHeight(mip_level));
+
+		FloorSpan span;
+		span.u_ = static_cast<float>(floor_x * texture_width);
+		span.v_ = static_cast<float>(floor_y * texture_height);
+		span.du_ = static_cast<float>(step_x * texture_width);
+		span.dv_ = static_cast<float>(step_y * texture_height);
+		span.texels_ = texture->GetColumn32(0, mip_level, Texture::GetShadeIndex(fog_level, true));
+		span.texture_width_ = texture_width;
+		span.texture_height_ = texture_height;
+
+		const FloorSpanKernel draw_span = GetFloorSpanKernel((texture_width & (texture_width - 1)) == 0 && (texture_height & (texture_height - 1)) == 0);
+		draw_span(span, y, wall_tops_.data(), wall_bottoms_.data(), bitmap->pixels_ + y * bitmap->pitch_, GetMapCoverWidth(y), view_width_);
 	}
 }
 
-void Player::DigitalDifferentialAnalysis(int x, Vect2d<double> ray_dir)
+void Player::CastRayBand(int begin_x, int end_x, RayScratch& scratch)
 {
-	Vect2d<int> map_check = { static_cast<int>(position_.x_), static_cast<int>(position_.y_) };
-	Vect2d<double> ray_step_size = { 0.0, 0.0 };
+	scratch.columns_drawn_ += end_x - begin_x;
+
+	if (game_->adaptive_toggled_)
+	{
+		CastRaysAdaptive(begin_x, end_x, scratch);
+	}
+	else if (game_->packets_toggled_ && !level_->IsStreamed())
+	{
+		CastRayPackets(begin_x, end_x, scratch);
+	}
+	else
+	{
+		for (int x = begin_x; x < end_x; ++x)
+		{
+			const Vect2d<double> ray_dir = GetRayDirection(x);
+			RayHit hit;
+
+			if (seed_from_cache_ && GetCachedHit(x, ray_dir, hit))
+			{
+				++scratch.rays_seeded_;
+			}
+			else
+			{
+				hit = DigitalDifferentialAnalysis(ray_dir);
+
+				++scratch.rays_cast_;
+				scratch.dda_steps_ += hit.steps_;
+			}
+
+			hits_[x] = hit;
+		}
+	}
+
+	// With the band's hits in place, runs of columns that see the same face are drawn together.
+	DrawWallStrips(begin_x, end_x, scratch);
+
+	if (screen_->bitmap_->IsColumnMajor())
+	{
+		// The band's columns are still in cache, so they go into the row-major frame right away.
+		screen_->bitmap_->TransposeColumns(begin_x, end_x);
+	}
+}
+
+void Player::FindSeedableColumns()
+{
+	// Faces only get hidden or uncovered where the last frame had an edge between two faces, and 
+	// the translation moves each edge by at most its reach. Every edge covers the columns it can 
+	// reach: +1 where the run starts and -1 past its end, summed up below.
+	std::fill(edge_coverage_.begin(), edge_coverage_.begin() + view_width_ + 1, 0);
+
+	const auto cover = [this](int first, int last)
+	{
+		++edge_coverage_[std::max(first, 0)];
+		--edge_coverage_[std::min(last, view_width_ - 1) + 1];
+	};
+
+	// Walls just off the screen can move onto it, and none of them is nearer than the closest wall around the player.
+	const int side_reach = GetEdgeReach(GetWallClearance());
+	cover(0, side_reach);
+	cover(view_width_ - 1 - side_reach, view_width_ - 1);
+
+	for (int x = 0; x + 1 < view_width_; ++x)
+	{
+		const RayHit& left = previous_hits_[x];
+		const RayHit& right = previous_hits_[x + 1];
+
+		if (left.map_x_ == right.map_x_ && left.map_y_ == right.map_y_ && left.wall_side_ == right.wall_side_)
+		{
+			continue;
+		}
+
+		// Neighbouring tiles of one straight wall meet in a flat seam that has nothing behind it.
+		const bool flat_seam = left.wall_side_ == right.wall_side_ && (left.wall_side_ == 0 ? 
+			left.map_x_ == right.map_x_ && std::abs(left.map_y_ - right.map_y_) == 1 : 
+			left.map_y_ == right.map_y_ && std::abs(left.map_x_ - right.map_x_) == 1);
+
+		if (!flat_seam)
+		{
+			const int reach = GetEdgeReach(std::min(left.distance_, right.distance_));
+			cover(x - reach, x + 1 + reach);
+		}
+	}
+
+	for (int x = 1; x < view_width_; ++x)
+	{
+		edge_coverage_[x] += edge_coverage_[x - 1];
+	}
+}
+
+int Player::GetEdgeReach(double distance)
+{
+	// Moving the camera by t shifts a point at depth z on the screen by at most 
+	// width * t * sqrt(1 + p^2) / (2 * p * (z - t)) columns, with p the length of the camera plane.
+	const double plane_length = plane_.GetLength();
+	const double stretch = std::sqrt(1.0 + plane_length * plane_length);
+	const double depth = distance * camera_.GetDirectionLength() - seed_translation_;
+
+	if (depth <= 0.0)
+	{
+		return view_width_;
+	}
+
+	const double reach = view_width_ * seed_translation_ * stretch / (2.0 * plane_length * depth);
+
+	return static_cast<int>(std::min(reach, static_cast<double>(view_width_))) + 1;
+}
+
+double Player::GetWallClearance()
+{
+	const int tile_x = static_cast<int>(position_.x_);
+	const int tile_y = static_cast<int>(position_.y_);
+
+	// Walls not next to the player's tile are at least a tile away, or further going by the distance field.
+	double clearance = std::max(level_->GetDistance(tile_x, tile_y) - 1, 1);
+
+	for (int y = tile_y - 1; y <= tile_y + 1; ++y)
+	{
+		for (int x = tile_x - 1; x <= tile_x + 1; ++x)
+		{
+			if (level_->IsWall(x, y))
+			{
+				const double gap_x = std::max({ x - position_.x_, 0.0f, position_.x_ - (x + 1) });
+				const double gap_y = std::max({ y - position_.y_, 0.0f, position_.y_ - (y + 1) });
+				clearance = std::min(clearance, std::sqrt(gap_x * gap_x + gap_y * gap_y));
+			}
+		}
+	}
+
+	return clearance;
+}
+
+bool Player::GetCachedHit(int x, const Vect2d<double>& ray_dir, RayHit& hit)
+{
+	if (edge_coverage_[x] != 0)
+	{
+		return false;
+	}
+
+	const RayHit& cached = previous_hits_[x];
+
+	// The column's ray keeps its direction, so it still meets the cached face as long as it lands within the tile.
+	if (cached.wall_side_ == 0)
+	{
+		const double face_x = ray_dir.x_ < 0 ? cached.map_x_ + 1 : cached.map_x_;
+		const double face_y = position_.y_ + (face_x - position_.x_) * ray_dir.y_ / ray_dir.x_;
+
+		if ((face_x - position_.x_) * ray_dir.x_ <= 0.0 || face_y < cached.map_y_ || face_y >= cached.map_y_ + 1)
+		{
+			return false;
+		}
+	}
+	else
+	{
+		const double face_y = ray_dir.y_ < 0 ? cached.map_y_ + 1 : cached.map_y_;
+		const double face_x = position_.x_ + (face_y - position_.y_) * ray_dir.x_ / ray_dir.y_;
+
+		if ((face_y - position_.y_) * ray_dir.y_ <= 0.0 || face_x < cached.map_x_ || face_x >= cached.map_x_ + 1)
+		{
+			return false;
+		}
+	}
+
+	hit = GetFaceHit(ray_dir, cached);
+
+	return true;
+}
+
+void Player::CastRaysAdaptive(int begin_x, int end_x, RayScratch& scratch)
+{
+	constexpr int spacing = constants::adaptive_ray_spacing;
+
+	// Slot i holds column segment_begin + i of the current segment.
+	Vect2d<double> ray_dirs[spacing + 1];
+	RayHit hits[spacing + 1];
+
+	int segment_begin = begin_x;
+	ray_dirs[0] = GetRayDirection(segment_begin);
+	hits[0] = CastAdaptiveRay(ray_dirs[0], scratch);
+
+	while (true)
+	{
+		const int segment_end = std::min(segment_begin + spacing, end_x - 1);
+		const int last = segment_end - segment_begin;
+
+		if (last > 0)
+		{
+			ray_dirs[last] = GetRayDirection(segment_end);
+			hits[last] = CastAdaptiveRay(ray_dirs[last], scratch);
+			RefineColumns(segment_begin, 0, last, ray_dirs, hits, scratch);
+		}
+
+		// The segment's last column is drawn as the first column of the next one.
+		const int draw_count = segment_end == end_x - 1 ? last + 1 : last;
+
+		for (int i = 0; i < draw_count; ++i)
+		{
+			hits_[segment_begin + i] = hits[i];
+		}
+
+		if (segment_end == end_x - 1)
+		{
+			return;
+		}
+
+		ray_dirs[0] = ray_dirs[last];
+		hits[0] = hits[last];
+		segment_begin = segment_end;
+	}
+}
+
+void Player::RefineColumns(int segment_begin, int low, int high, Vect2d<double>* ray_dirs, RayHit* hits, RayScratch& scratch)
+{
+	if (high - low < 2)
+	{
+		return;
+	}
+
+	if (HitsShareFace(hits[low], hits[high]))
+	{
+		// Every ray in between hits the same face, so its distance follows from where the face lies.
+		for (int i = low + 1; i < high; ++i)
+		{
+			ray_dirs[i] = GetRayDirection(segment_begin + i);
+			hits[i] = GetFaceHit(ray_dirs[i], hits[low]);
+		}
+
+		return;
+	}
+
+	const int middle = (low + high) / 2;
+	ray_dirs[middle] = GetRayDirection(segment_begin + middle);
+	hits[middle] = CastAdaptiveRay(ray_dirs[middle], scratch);
+
+	RefineColumns(segment_begin, low, middle, ray_dirs, hits, scratch);
+	RefineColumns(segment_begin, middle, high, ray_dirs, hits, scratch);
+}
+
+RayHit Player::CastAdaptiveRay(const Vect2d<double>& ray_dir, RayScratch& scratch)
+{
+	const RayHit hit = DigitalDifferentialAnalysis(ray_dir);
+
+	++scratch.rays_cast_;
+	scratch.dda_steps_ += hit.steps_;
+
+	return hit;
+}
 
-	if (game_->fisheye_effect_toggled_)
+bool Player::HitsShareFace(const RayHit& hit1, const RayHit& hit2)
+{
+	if (hit1.map_x_ != hit2.map_x_ || hit1.map_y_ != hit2.map_y_ || hit1.wall_side_ != hit2.wall_side_)
 	{
-		ray_step_size = { std::abs(1 / ray_dir.x_), std::abs(1 / ray_dir.y_) };
+		return false;
+	}
+
+	// A steep change in distance across a face seen at a grazing angle is refined too, since a 
+	// narrow occluder is the likeliest to slip between the coarse rays there.
+	return std::abs(hit1.distance_ - hit2.distance_) <= constants::adaptive_max_distance_change * std::min(hit1.distance_, hit2.distance_);
+}
+
+RayHit Player::GetFaceHit(const Vect2d<double>& ray_dir, const RayHit& face)
+{
+	const Vect2d<double> ray_step_size = GetRayStepSize(ray_dir);
+	double distance = 0.0;
+
+	if (face.wall_side_ == 0)
+	{
+		const double face_x = ray_dir.x_ < 0 ? face.map_x_ + 1 : face.map_x_;
+		distance = std::abs(face_x - position_.x_) * ray_step_size.x_;
 	}
 	else
 	{
-		ray_step_size = { std::sqrt(1 + ((ray_dir.y_ / ray_dir.x_) * (ray_dir.y_ / ray_dir.x_))), std::sqrt(1 + ((ray_dir.x_ / ray_dir.y_) * (ray_dir.x_ / ray_dir.y_))) };
+		const double face_y = ray_dir.y_ < 0 ? face.map_y_ + 1 : face.map_y_;
+		distance = std::abs(face_y - position_.y_) * ray_step_size.y_;
+	}
+
+	return { face.map_x_, face.map_y_, face.wall_side_, 0, distance };
+}
+
+void Player::CastRayPackets(int begin_x, int end_x, RayScratch& scratch)
+{
+	constexpr int lane_count = PacketTracer::lane_count;
+
+	for (int x = begin_x; x < end_x; x += lane_count)
+	{
+		const int count = std::min(lane_count, end_x - x);
+
+		float ray_dirs_x[lane_count];
+		float ray_dirs_y[lane_count];
+		RayHit hits[lane_count];
+
+		for (int lane = 0; lane < count; ++lane)
+		{
+			const Vect2d<double> ray_dir = GetRayDirection(x + lane);
+			ray_dirs_x[lane] = static_cast<float>(ray_dir.x_);
+			ray_dirs_y[lane] = static_cast<float>(ray_dir.y_);
+		}
+
+		packet_tracer_.TracePacket(position_, ray_dirs_x, ray_dirs_y, count, GetTraceSettings(), hits);
+
+		for (int lane = 0; lane < count; ++lane)
+		{
+			++scratch.rays_cast_;
+			scratch.dda_steps_ += hits[lane].steps_;
+
+			hits_[x + lane] = hits[lane];
+		}
+	}
+}
+
+TraceSettings Player::GetTraceSettings()
+{
+	return { game_->skipping_toggled_, game_->hierarchical_toggled_ };
+}
+
+int Player::GetViewPitch()
+{
+	return constants::view_pitch * view_height_ / constants::screen_height;
+}
+
+int Player::GetFogLevel(double distance)
+{
+	if (!game_->fog_toggled_)
+	{
+		return 0;
+	}
+
+	// Walls facing the camera at a level boundary land on it up to rounding noise, which the bias 
+	// resolves the same way in every column instead of striping the wall.
+	const double level = distance * constants::fog_level_count / constants::fog_distance + 1e-9;
+
+	return std::min(constants::fog_level_count - 1, static_cast<int>(level));
+}
+
+Vect2d<double> Player::GetRayDirection(int x)
+{
+	return camera_.GetRayDirection(x);
+}
+
+RayScratch Player::CollectRayStats()
+{
+	RayScratch total = { 0, 0, 0, 0, 0, 0, 0 };
+
+	for (RayScratch& scratch : ray_scratch_)
+	{
+		total.rays_cast_ += scratch.rays_cast_;
+		total.dda_steps_ += scratch.dda_steps_;
+		total.columns_drawn_ += scratch.columns_drawn_;
+		total.rays_seeded_ += scratch.rays_seeded_;
+		total.frames_reused_ += scratch.frames_reused_;
+		total.strips_drawn_ += scratch.strips_drawn_;
+		total.pixels_cleared_ += scratch.pixels_cleared_;
+		scratch = { 0, 0, 0, 0, 0, 0, 0 };
+	}
+
+	return total;
+}
+
+void Player::ComparePacketTracer()
+{
+	constexpr int lane_count = PacketTracer::lane_count;
+
+	if (level_->IsStreamed())
+	{
+		printf("The packet tracer needs a level held in memory, not a chunked one.\n");
+		return;
+	}
+
+	camera_.Update(view_width_, direction_, plane_);
+
+	int hit_mismatches = 0;
+	int side_mismatches = 0;
+	double max_distance_error = 0.0;
+	std::uint64_t scalar_time = 0;
+	std::uint64_t packet_time = 0;
+
+	for (int x = 0; x < view_width_; x += lane_count)
+	{
+		const int count = std::min(lane_count, view_width_ - x);
+
+		float ray_dirs_x[lane_count];
+		float ray_dirs_y[lane_count];
+		RayHit scalar_hits[lane_count];
+		RayHit packet_hits[lane_count];
+
+		const std::uint64_t scalar_start = SDL_GetPerformanceCounter();
+
+		for (int lane = 0; lane < count; ++lane)
+		{
+			scalar_hits[lane] = DigitalDifferentialAnalysis(GetRayDirection(x + lane));
+		}
+
+		const std::uint64_t packet_start = SDL_GetPerformanceCounter();
+
+		for (int lane = 0; lane < count; ++lane)
+		{
+			const Vect2d<double> ray_dir = GetRayDirection(x + lane);
+			ray_dirs_x[lane] = static_cast<float>(ray_dir.x_);
+			ray_dirs_y[lane] = static_cast<float>(ray_dir.y_);
+		}
+
+		packet_tracer_.TracePacket(position_, ray_dirs_x, ray_dirs_y, count, GetTraceSettings(), packet_hits);
+
+		const std::uint64_t packet_end = SDL_GetPerformanceCounter();
+		scalar_time += packet_start - scalar_start;
+		packet_time += packet_end - packet_start;
+
+		for (int lane = 0; lane < count; ++lane)
+		{
+			if (scalar_hits[lane].map_x_ != packet_hits[lane].map_x_ || scalar_hits[lane].map_y_ != packet_hits[lane].map_y_)
+			{
+				++hit_mismatches;
+				continue;
+			}
+
+			if (scalar_hits[lane].wall_side_ != packet_hits[lane].wall_side_)
+			{
+				++side_mismatches;
+				continue;
+			}
+
+			max_distance_error = std::max(max_distance_error, std::abs(scalar_hits[lane].distance_ - packet_hits[lane].distance_));
+		}
+	}
+
+	const double frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+	printf("Packet tracer (%d lanes): %d hit and %d side mismatches in %d rays, max distance error %g, scalar %.3f ms, packet %.3f ms\n", 
+		lane_count, hit_mismatches, side_mismatches, view_width_, max_distance_error, 1000.0 * scalar_time / frequency, 1000.0 * packet_time / frequency);
+}
+
+void Player::CompareDdaBackends(int frames)
+{
+	camera_.Update(view_width_, direction_, plane_);
+
+	std::vector<RayHit> floating_hits(view_width_);
+	std::vector<RayHit> fixed_hits(view_width_);
+	std::uint64_t floating_time = 0;
+	std::uint64_t fixed_time = 0;
+
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		const std::uint64_t floating_start = SDL_GetPerformanceCounter();
+
+		for (int x = 0; x < view_width_; ++x)
+		{
+			floating_hits[x] = DigitalDifferentialAnalysis<double>(GetRayDirection(x));
+		}
+
+		const std::uint64_t fixed_start = SDL_GetPerformanceCounter();
+
+		for (int x = 0; x < view_width_; ++x)
+		{
+			fixed_hits[x] = DigitalDifferentialAnalysis<Fixed16>(GetRayDirection(x));
+		}
+
+		const std::uint64_t fixed_end = SDL_GetPerformanceCounter();
+		floating_time += fixed_start - floating_start;
+		fixed_time += fixed_end - fixed_start;
+	}
+
+	int hit_mismatches = 0;
+	int side_mismatches = 0;
+	double max_distance_error = 0.0;
+
+	for (int x = 0; x < view_width_; ++x)
+	{
+		if (floating_hits[x].map_x_ != fixed_hits[x].map_x_ || floating_hits[x].map_y_ != fixed_hits[x].map_y_)
+		{
+			++hit_mismatches;
+		}
+		else if (floating_hits[x].wall_side_ != fixed_hits[x].wall_side_)
+		{
+			++side_mismatches;
+		}
+		else
+		{
+			max_distance_error = std::max(max_distance_error, std::abs(floating_hits[x].distance_ - fixed_hits[x].distance_));
+		}
 	}
 
-	Vect2d<double> ray_length = { 0.0, 0.0 };
+	const double frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+	printf("DDA backends: %d hit and %d side mismatches in %d rays, max distance error %g, double %.3f ms, fixed-point %.3f ms per frame\n", 
+		hit_mismatches, side_mismatches, view_width_, max_distance_error, 1000.0 * floating_time / frequency / frames, 1000.0 * fixed_time / frequency / frames);
+}
+
+Vect2d<double> Player::GetRayStepSize(const Vect2d<double>& ray_dir)
+{
+	// Distances along the ray are measured in units of ray_dir, which the wall pass turns into 
+	// perpendicular ones with a multiplication.
+	return { GetAxisStepSize<double>(ray_dir.x_), GetAxisStepSize<double>(ray_dir.y_) };
+}
+
+template <typename T>
+RayHit Player::DigitalDifferentialAnalysis(const Vect2d<double>& ray_dir)
+{
+	Vect2d<int> map_check = { static_cast<int>(position_.x_), static_cast<int>(position_.y_) };
+	const Vect2d<T> ray_step_size = { GetAxisStepSize<T>(ray_dir.x_), GetAxisStepSize<T>(ray_dir.y_) };
+
+	Vect2d<T> ray_length = { ToScalar<T>(0.0), ToScalar<T>(0.0) };
 	Vect2d<int> step = { 0, 0 };
 
 	bool wall_hit = false;
@@ -248,34 +915,45 @@ void Player::DigitalDifferentialAnalysis(int x, Vect2d<double> ray_dir)
 	if (ray_dir.x_ < 0)
 	{
 		step.x_ = -1;
-		ray_length.x_ = (position_.x_ - map_check.x_) * ray_step_size.x_;
+		ray_length.x_ = ToScalar<T>(position_.x_ - map_check.x_) * ray_step_size.x_;
 	}
 	else
 	{
 		step.x_ = 1;
-		ray_length.x_ = (map_check.x_ + 1 - position_.x_) * ray_step_size.x_;
+		ray_length.x_ = ToScalar<T>(map_check.x_ + 1 - position_.x_) * ray_step_size.x_;
 	}
 
 	if (ray_dir.y_ < 0)
 	{
 		step.y_ = -1;
-		ray_length.y_ = (position_.y_ - map_check.y_) * ray_step_size.y_;
+		ray_length.y_ = ToScalar<T>(position_.y_ - map_check.y_) * ray_step_size.y_;
 	}
 	else
 	{
 		step.y_ = 1;
-		ray_length.y_ = (map_check.y_ + 1 - position_.y_) * ray_step_size.y_;
+		ray_length.y_ = ToScalar<T>(map_check.y_ + 1 - position_.y_) * ray_step_size.y_;
 	}
 
+	const int max_steps = level_->GetMaxRaySteps();
 	int loop_guard = 0;
 
 	while (!wall_hit)
 	{
-		if (++loop_guard == 10000)
+		if (++loop_guard == max_steps)
 		{
 			assert(false);
 		}
 
+		int reach_x = 0;
+		int reach_y = 0;
+
+		if (level_->GetEmptyReach(map_check.x_, map_check.y_, step.x_, step.y_, game_->skipping_toggled_, game_->hierarchical_toggled_, reach_x, reach_y))
+		{
+			// Nothing but empty tiles lies within reach, so every grid crossing before leaving it is 
+			// jumped at once; the step below then continues from there.
+			SkipCrossings(reach_x, reach_y, ray_step_size.x_, ray_step_size.y_, step.x_, step.y_, ray_length.x_, ray_length.y_, map_check.x_, map_check.y_);
+		}
+
 		if (ray_length.x_ < ray_length.y_)
 		{
 			ray_length.x_ += ray_step_size.x_;
@@ -289,14 +967,11 @@ void Player::DigitalDifferentialAnalysis(int x, Vect2d<double> ray_dir)
 			wall_side = 1;
 		}
 
-		auto map_tile = level_->GetTile(map_check.x_, map_check.y_);
-		wall_hit = map_tile != nullptr && level_->GetTile(map_check.x_, map_check.y_)->is_wall_;
+		wall_hit = level_->IsWall(map_check.x_, map_check.y_);
 	}
 
 	assert(wall_side != -1);
 
-	Tile* tile_hit = level_->GetTile(map_check.x_, map_check.y_);
-
 	if (wall_side == 0)
 	{
 		ray_length.x_ -= ray_step_size.x_;
@@ -305,119 +980,154 @@ void Player::DigitalDifferentialAnalysis(int x, Vect2d<double> ray_dir)
 	{
 		ray_length.y_ -= ray_step_size.y_;
 	}
-	
-	const double pi = std::acos(-1);
-	const double dot = std::clamp(((ray_dir.x_ * direction_.x_) + (ray_dir.y_ * direction_.y_)) / (ray_dir.GetLength() * direction_.GetLength()), -1.0, 1.0);
-	const double rad_angle = std::acos(dot);
-	[[maybe_unused]] const double deg_angle = (rad_angle * (180.0 / pi));
-	
-	double wall_dist = wall_side == 0 ? ray_length.x_ : ray_length.y_;
-	wall_dist *= std::cos(rad_angle);	
 
-	int line_height = static_cast<int>(constants::screen_height / wall_dist);
-	int pitch = 100;
-	int draw_start = -line_height / 2 + constants::screen_height / 2 + pitch;
+	return { map_check.x_, map_check.y_, wall_side, loop_guard, ToDouble(wall_side == 0 ? ray_length.x_ : ray_length.y_) };
+}
 
-	if (draw_start < 0) 
-	{
-		draw_start = 0;
-	}
-	
-	int draw_end = line_height / 2 + constants::screen_height / 2 + pitch;
-	
-	if (draw_end >= constants::screen_height)
+void Player::DrawWallStrips(int begin_x, int end_x, RayScratch& scratch)
+{
+	for (int x = begin_x; x < end_x; )
 	{
-		draw_end = constants::screen_height - 1;
-	}
+		const RayHit& hit = hits_[x];
+		int strip_end = x + 1;
+
+		while (strip_end < end_x && hits_[strip_end].map_x_ == hit.map_x_ && hits_[strip_end].map_y_ == hit.map_y_ && hits_[strip_end].wall_side_ == hit.wall_side_)
+		{
+			++strip_end;
+		}
 
-	SDL_Color color = tile_hit->color_;
+		DrawWallStrip(x, strip_end, scratch);
+		++scratch.strips_drawn_;
+		x = strip_end;
+	}
+}
 
-	if (game_->textures_toggled_)
+void Player::DrawWallStrip(int begin_x, int end_x, RayScratch& scratch)
+{
+	// Every column of the strip shows the same face of the same tile, so everything but the 
+	// column's distance and texture column is looked up once here.
+	const RayHit& face = hits_[begin_x];
+	const int wall_side = face.wall_side_;
+	const std::uint8_t material = level_->GetMaterial(face.map_x_, face.map_y_);
+	const Texture* current_texture = game_->textures_toggled_ ? level_->GetMaterialTexture(material) : nullptr;
+	const int pitch = GetViewPitch();
+	const std::uint32_t clear_color = screen_->bitmap_->GetClearColor();
+
+	// Both faces of a tile along one axis can never be in view at once, so the ray's sign along it is the strip's.
+	const Vect2d<double> first_ray_dir = GetRayDirection(begin_x);
+	const bool flip_tex_x = (wall_side == 0 && first_ray_dir.x_ > 0) || (wall_side == 1 && first_ray_dir.y_ < 0);
+	const bool contiguous = screen_->bitmap_->IsColumnMajor();
+	const int tex_height = current_texture == nullptr ? 0 : static_cast<int>(current_texture->height_);
+	const int mip_count = current_texture == nullptr ? 1 : current_texture->GetMipCount();
+
+	for (int x = begin_x; x < end_x; ++x)
 	{
-		const SDL_Color red = { 0xff, 0x00, 0x00, 0xff };
-		const SDL_Color green = { 0x00, 0xff, 0x00, 0xff };
-		const SDL_Color blue = { 0x00, 0x00, 0xff, 0xff };
-		const SDL_Color yellow = { 0xff, 0xff, 0x00, 0xff };
+		const Vect2d<double> ray_dir = GetRayDirection(x);
 
-		Texture* current_texture = nullptr;
+		// The camera plane is at right angles to the view direction, so a hit at distance t along the ray 
+		// lies t times the direction's length in front of the camera. The 'fisheye' view divides by the 
+		// ray's length on top, which bends the walls away towards the sides.
+		double wall_dist = hits_[x].distance_ * camera_.GetDirectionLength();
 
-		if (game_->ColorsEqual(color, red))
-		{
-			current_texture = game_->textures_[0].get();
-		}
-		else if (game_->ColorsEqual(color, green))
+		if (game_->fisheye_effect_toggled_)
 		{
-			current_texture = game_->textures_[1].get();
-		}
-		else if (game_->ColorsEqual(color, blue))
-		{
-			current_texture = game_->textures_[2].get();
-		}
-		else if (game_->ColorsEqual(color, yellow))
-		{
-			current_texture = game_->textures_[3].get();
-		}
-		else
-		{
-			return;
+			wall_dist /= camera_.GetRayLength(x);
 		}
 
-		std::uint32_t* tex_pixels = current_texture->GetPixels32();
+		const int line_height = static_cast<int>(view_height_ / wall_dist);
+		const int draw_start = std::max(-line_height / 2 + view_height_ / 2 + pitch, 0);
+		const int draw_end = std::min(line_height / 2 + view_height_ / 2 + pitch, view_height_ - 1);
 
-		double wall_x = 0.0;
-		int tex_width = 64;
-		int tex_height = 64;
+		wall_tops_[x] = draw_start;
+		wall_bottoms_[x] = draw_end;
 
-		if (wall_side == 0)
-		{
-			wall_x = position_.y_ + wall_dist * ray_dir.y_;
-		}
-		else
+		// Side shading and fog are baked into the texture and material variants, so the spans below only copy.
+		const int shade = Texture::GetShadeIndex(GetFogLevel(wall_dist), wall_side == 1);
+
+		std::ptrdiff_t stride = 0;
+		std::uint32_t* column = screen_->bitmap_->GetColumn(x, stride);
+
+		if (contiguous)
 		{
-			wall_x = position_.x_ + wall_dist * ray_dir.x_;
+			// Nothing clears the column-major target, so the spans around the wall are filled here, contiguously.
+			std::fill(column, column + draw_start, clear_color);
+			std::fill(column + draw_end, column + view_height_, clear_color);
+			scratch.pixels_cleared_ += draw_start + view_height_ - draw_end;
 		}
 
-		wall_x -= std::floor(wall_x);
+		if (!game_->textures_toggled_)
+		{
+			const std::uint32_t pixel_color = level_->GetMaterialShade(material, shade);
 
-		int tex_x = static_cast<int>(wall_x * static_cast<double>(tex_width));
+			if (contiguous)
+			{
+				std::fill(column + draw_start, column + draw_end, pixel_color);
+			}
+			else
+			{
+				for (int y = draw_start; y < draw_end; ++y)
+				{
+					column[y * stride] = pixel_color;
+				}
+			}
 
-		if (wall_side == 0 && ray_dir.x_ > 0)
-		{
-			tex_x = tex_width - tex_x - 1;
+			continue;
 		}
 
-		if (wall_side == 1 && ray_dir.y_ < 0)
+		if (current_texture == nullptr)
 		{
-			tex_x = tex_width - tex_x - 1;
+			// A material without a texture shows the clear color, which only the full clear already put there.
+			if (contiguous)
+			{
+				std::fill(column + draw_start, column + draw_end, clear_color);
+				scratch.pixels_cleared_ += std::max(draw_end - draw_start, 0);
+			}
+			else if (!game_->full_clear_toggled_)
+			{
+				for (int y = draw_start; y < draw_end; ++y)
+				{
+					column[y * stride] = clear_color;
+				}
+
+				scratch.pixels_cleared_ += std::max(draw_end - draw_start, 0);
+			}
+
+			continue;
 		}
 
+		double wall_x = wall_side == 0 ? position_.y_ + wall_dist * ray_dir.y_ : position_.x_ + wall_dist * ray_dir.x_;
+		wall_x -= std::floor(wall_x);
+
 		double tex_step = 1.0 * tex_height / line_height;
-		double tex_pos = (draw_start - pitch - constants::screen_height / 2 + line_height - 2) * tex_step;
+		int mip_level = 0;
 
-		for (int y = draw_start; y < draw_end; ++y)
+		if (game_->mipmaps_toggled_)
 		{
-			int tex_y = static_cast<int>(tex_pos) & (tex_height - 1);
-			tex_pos += tex_step;
-			std::uint32_t pixel_color = tex_pixels[tex_height * tex_y + tex_x];
-
-			if (wall_side == 1)
+			// Far walls skip texels with every pixel; halving until the step is below two texels keeps 
+			// them reading a small mip that stays in cache and does not alias.
+			while (tex_step >= 2.0 && mip_level + 1 < mip_count)
 			{
-				pixel_color = (pixel_color >> 1) & 8355711;
+				tex_step *= 0.5;
+				++mip_level;
 			}
-
-			screen_->bitmap_->DrawPoint(x, y, pixel_color);
 		}
 
-	}
-	else
-	{
-		if (wall_side == 1)
+		// Taken in the mip's own texels, which also keeps it in range for sizes that do not halve evenly.
+		const int mip_width = static_cast<int>(current_texture->GetMipWidth(mip_level));
+		int tex_x = static_cast<int>(wall_x * static_cast<double>(mip_width));
+
+		if (flip_tex_x)
 		{
-			color.r /= 2;
-			color.g /= 2;
-			color.b /= 2;
+			tex_x = mip_width - tex_x - 1;
 		}
-		
-		screen_->bitmap_->DrawLine(x, draw_start, x, draw_end, game_->GetColor(color));
+
+		WallSpan span;
+		span.texels_ = current_texture->GetColumn32(tex_x, mip_level, shade);
+		span.tex_pos_ = (draw_start - pitch - view_height_ / 2 + line_height - 2) * tex_step;
+		span.tex_step_ = tex_step;
+		span.texture_height_ = static_cast<int>(current_texture->GetMipHeight(mip_level));
+
+		// The clipped start and the step are known here, so the kernel is picked for this column's texels.
+		GetWallSpanKernel(contiguous, span, draw_end - draw_start)(span, column, stride, draw_start, draw_end);
 	}
 }
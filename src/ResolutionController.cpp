@@ -0,0 +1,76 @@
+#include "ResolutionController.hpp"
+
+namespace
+{
+	// Weight of the newest frame in the running average.
+	constexpr double smoothing = 0.1;
+	// Frames to wait after a change before judging the new resolution.
+	constexpr int settle_frame_count = 15;
+	// Headroom the predicted frame time must leave before the resolution goes up again.
+	constexpr double raise_margin = 0.9;
+}
+
+ResolutionController::ResolutionController(double target_frame_ms) : 
+	target_frame_ms_(target_frame_ms), 
+	average_frame_ms_(0.0), 
+	scale_step_(scale_steps), 
+	settle_frames_(0), 
+	measured_(false)
+{
+}
+
+void ResolutionController::Reset()
+{
+	average_frame_ms_ = 0.0;
+	scale_step_ = scale_steps;
+	settle_frames_ = 0;
+	measured_ = false;
+}
+
+void ResolutionController::Update(double frame_ms)
+{
+	average_frame_ms_ = measured_ ? average_frame_ms_ + smoothing * (frame_ms - average_frame_ms_) : frame_ms;
+	measured_ = true;
+
+	if (settle_frames_ > 0)
+	{
+		--settle_frames_;
+		return;
+	}
+
+	if (average_frame_ms_ > target_frame_ms_ && scale_step_ > min_scale_step)
+	{
+		--scale_step_;
+		settle_frames_ = settle_frame_count;
+		return;
+	}
+
+	// Frame time grows with the pixel count, so a step up is only taken if it is predicted to fit.
+	const double growth = static_cast<double>(scale_step_ + 1) / scale_step_;
+
+	if (scale_step_ < scale_steps && average_frame_ms_ * growth * growth < target_frame_ms_ * raise_margin)
+	{
+		++scale_step_;
+		settle_frames_ = settle_frame_count;
+	}
+}
+
+double ResolutionController::GetScale() const
+{
+	return static_cast<double>(scale_step_) / scale_steps;
+}
+
+int ResolutionController::Scale(int size) const
+{
+	return size * scale_step_ / scale_steps;
+}
+
+double ResolutionController::GetAverageFrameMs() const
+{
+	return average_frame_ms_;
+}
+
+double ResolutionController::GetTargetFrameMs() const
+{
+	return target_frame_ms_;
+}
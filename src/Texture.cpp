@@ -1,5 +1,6 @@
 #include "Texture.hpp"
 #include "Game.hpp"
+#include "Constants.hpp"
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
@@ -8,6 +9,7 @@ Texture::Texture(Game* game) :
     game_(game), 
     texture_(nullptr), 
     surface_(nullptr), 
+    shade_size_(0), 
     width_(0), 
     height_(0)
 {
@@ -32,6 +34,9 @@ void Texture::Free()
         surface_ = nullptr;
     }
 
+    columns_.clear();
+    mip_offsets_.clear();
+    shade_size_ = 0;
     width_ = 0;
     height_ = 0;
 }
@@ -77,6 +82,22 @@ bool Texture::LoadPixelsFromFile(const char* path)
     height_ = surface_->h;
     SDL_FreeSurface(loaded_surface);
 
+    const std::uint32_t* pixels = GetPixels32();
+    const std::uint32_t pitch = GetPitch32();
+    columns_.resize(width_ * height_);
+    mip_offsets_.assign(1, 0);
+
+    for (std::size_t x = 0; x < width_; ++x)
+    {
+        for (std::size_t y = 0; y < height_; ++y)
+        {
+            columns_[x * height_ + y] = pixels[y * pitch + x];
+        }
+    }
+
+    BuildMipChain();
+    BuildShades();
+
     return true;
 }
 
@@ -142,3 +163,101 @@ std::uint32_t Texture::MapRGBA(std::uint8_t r, std::uint8_t g, std::uint8_t b, s
 
 	return pixel;
 }
+
+void Texture::BuildMipChain()
+{
+    std::size_t width = width_;
+    std::size_t height = height_;
+
+    while (width > 1 || height > 1)
+    {
+        const std::size_t mip_width = std::max<std::size_t>(width / 2, 1);
+        const std::size_t mip_height = std::max<std::size_t>(height / 2, 1);
+        const std::size_t source_offset = mip_offsets_.back();
+        const std::size_t mip_offset = columns_.size();
+
+        columns_.resize(mip_offset + mip_width * mip_height);
+        mip_offsets_.push_back(mip_offset);
+
+        for (std::size_t x = 0; x < mip_width; ++x)
+        {
+            const std::size_t x0 = std::min(2 * x, width - 1);
+            const std::size_t x1 = std::min(2 * x + 1, width - 1);
+
+            for (std::size_t y = 0; y < mip_height; ++y)
+            {
+                const std::size_t y0 = std::min(2 * y, height - 1);
+                const std::size_t y1 = std::min(2 * y + 1, height - 1);
+
+                const std::uint32_t texels[4] = 
+                {
+                    columns_[source_offset + x0 * height + y0], 
+                    columns_[source_offset + x0 * height + y1], 
+                    columns_[source_offset + x1 * height + y0], 
+                    columns_[source_offset + x1 * height + y1]
+                };
+
+                // Averages each 8-bit channel separately, rounding to nearest.
+                std::uint32_t texel = 0;
+
+                for (int shift = 0; shift < 32; shift += 8)
+                {
+                    std::uint32_t sum = 2;
+
+                    for (const std::uint32_t source : texels)
+                    {
+                        sum += (source >> shift) & 0xff;
+                    }
+
+                    texel |= (sum / 4) << shift;
+                }
+
+                columns_[mip_offset + x * mip_height + y] = texel;
+            }
+        }
+
+        width = mip_width;
+        height = mip_height;
+    }
+}
+
+void Texture::BuildShades()
+{
+    constexpr int shade_count = 2 * constants::fog_level_count;
+
+    shade_size_ = columns_.size();
+    columns_.resize(shade_size_ * shade_count);
+
+    for (int shade = shade_count - 1; shade >= 0; --shade)
+    {
+        for (std::size_t i = 0; i < shade_size_; ++i)
+        {
+            columns_[shade * shade_size_ + i] = ShadeTexel(columns_[i], shade);
+        }
+    }
+}
+
+std::uint32_t Texture::ShadeTexel(std::uint32_t texel, int shade)
+{
+    const int fog_level = shade / 2;
+
+    if (fog_level > 0)
+    {
+        const std::uint32_t brightness = constants::fog_level_count - fog_level;
+        std::uint32_t fogged = texel & 0xff000000;
+
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            fogged |= (((texel >> shift) & 0xff) * brightness / constants::fog_level_count) << shift;
+        }
+
+        texel = fogged;
+    }
+
+    if (shade % 2 == 1)
+    {
+        texel = (texel >> 1) & 8355711;
+    }
+
+    return texel;
+}
@@ -0,0 +1,110 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(std::size_t thread_count) : 
+	job_(nullptr), 
+	job_end_(0), 
+	band_size_(1), 
+	next_band_begin_(0), 
+	generation_(0), 
+	pending_workers_(0), 
+	stopping_(false)
+{
+	for (std::size_t i = 1; i < thread_count; ++i)
+	{
+		workers_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		const std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+
+	work_available_.notify_all();
+
+	for (std::thread& worker : workers_)
+	{
+		worker.join();
+	}
+}
+
+std::size_t ThreadPool::GetThreadCount()
+{
+	return workers_.size() + 1;
+}
+
+void ThreadPool::ParallelFor(int begin, int end, int band_size, const Job& job)
+{
+	band_size = std::max(band_size, 1);
+
+	if (workers_.empty() || end - begin <= band_size)
+	{
+		for (int band_begin = begin; band_begin < end; band_begin += band_size)
+		{
+			job(band_begin, std::min(band_begin + band_size, end), 0);
+		}
+
+		return;
+	}
+
+	{
+		const std::lock_guard<std::mutex> lock(mutex_);
+		job_ = &job;
+		job_end_ = end;
+		band_size_ = band_size;
+		next_band_begin_.store(begin);
+		pending_workers_ = workers_.size();
+		++generation_;
+	}
+
+	work_available_.notify_all();
+	RunBands(0);
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	work_done_.wait(lock, [this]() { return pending_workers_ == 0; });
+	job_ = nullptr;
+}
+
+void ThreadPool::WorkerLoop(std::size_t worker_index)
+{
+	std::size_t seen_generation = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			work_available_.wait(lock, [this, seen_generation]() { return stopping_ || generation_ != seen_generation; });
+
+			if (stopping_)
+			{
+				return;
+			}
+
+			seen_generation = generation_;
+		}
+
+		RunBands(worker_index);
+
+		{
+			const std::lock_guard<std::mutex> lock(mutex_);
+
+			if (--pending_workers_ == 0)
+			{
+				work_done_.notify_one();
+			}
+		}
+	}
+}
+
+void ThreadPool::RunBands(std::size_t worker_index)
+{
+	// Bands are handed out dynamically so a worker that drew cheap columns keeps pulling work.
+	for (int band_begin = next_band_begin_.fetch_add(band_size_); band_begin < job_end_; band_begin = next_band_begin_.fetch_add(band_size_))
+	{
+		(*job_)(band_begin, std::min(band_begin + band_size_, job_end_), worker_index);
+	}
+}
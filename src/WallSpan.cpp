@@ -0,0 +1,96 @@
+#include "WallSpan.hpp"
+
+namespace
+{
+	enum class WallSpanWrap
+	{
+		// The span's texels all lie in one repeat of the texture, so they are read without wrapping.
+		None, 
+		Mask, 
+		// Other heights are read in runs that each stay within one repeat, instead of taking a remainder per pixel.
+		Runs
+	};
+
+	// Start of the texture repeat texel tex_y is in; tiny walls start a texel or two above the texture, so it can be negative.
+	int GetTextureBase(int tex_y, int texture_height)
+	{
+		const int remainder = tex_y % texture_height;
+		return tex_y - (remainder < 0 ? remainder + texture_height : remainder);
+	}
+
+	template <bool Contiguous, WallSpanWrap Wrap>
+	void DrawWallSpan(const WallSpan& span, std::uint32_t* column, std::ptrdiff_t stride, int begin_y, int end_y)
+	{
+		const std::ptrdiff_t pixel_stride = Contiguous ? 1 : stride;
+		const int texture_height = span.texture_height_;
+		const std::uint32_t* texels = span.texels_;
+		const double tex_step = span.tex_step_;
+		double tex_pos = span.tex_pos_;
+
+		if constexpr (Wrap == WallSpanWrap::None)
+		{
+			const int texture_base = GetTextureBase(static_cast<int>(tex_pos), texture_height);
+
+			for (int y = begin_y; y < end_y; ++y)
+			{
+				const int tex_y = static_cast<int>(tex_pos);
+				tex_pos += tex_step;
+				column[y * pixel_stride] = texels[tex_y - texture_base];
+			}
+		}
+		else if constexpr (Wrap == WallSpanWrap::Mask)
+		{
+			for (int y = begin_y; y < end_y; ++y)
+			{
+				const int tex_y = static_cast<int>(tex_pos);
+				tex_pos += tex_step;
+				column[y * pixel_stride] = texels[tex_y & (texture_height - 1)];
+			}
+		}
+		else
+		{
+			int y = begin_y;
+
+			while (y < end_y)
+			{
+				const int texture_base = GetTextureBase(static_cast<int>(tex_pos), texture_height);
+				const int texture_end = texture_base + texture_height;
+
+				for (; y < end_y; ++y)
+				{
+					const int tex_y = static_cast<int>(tex_pos);
+
+					if (tex_y >= texture_end)
+					{
+						break;
+					}
+
+					tex_pos += tex_step;
+					column[y * pixel_stride] = texels[tex_y - texture_base];
+				}
+			}
+		}
+	}
+
+	template <bool Contiguous>
+	WallSpanKernel GetWallSpanKernel(const WallSpan& span, int row_count)
+	{
+		const int texture_height = span.texture_height_;
+
+		// Clipped walls of near tiles only show part of the texture. The last position is the first plus the steps, 
+		// give or take rounding far below the texel the margin leaves, so the check never lets a wrap through.
+		const double last_pos = span.tex_pos_ + (row_count - 1) * span.tex_step_;
+
+		if (span.tex_pos_ >= 0.0 && last_pos + 1.0 < GetTextureBase(static_cast<int>(span.tex_pos_), texture_height) + texture_height)
+		{
+			return &DrawWallSpan<Contiguous, WallSpanWrap::None>;
+		}
+
+		return (texture_height & (texture_height - 1)) == 0 ? &DrawWallSpan<Contiguous, WallSpanWrap::Mask> : &DrawWallSpan<Contiguous, WallSpanWrap::Runs>;
+	}
+} // namespace
+
+WallSpanKernel GetWallSpanKernel(bool contiguous, const WallSpan& span, int row_count)
+{
+	return contiguous ? GetWallSpanKernel<true>(span, row_count) : GetWallSpanKernel<false>(span, row_count);
+}
@@ -1,15 +1,13 @@
 #include "Game.hpp"
+#include "Options.hpp"
 
 #include <memory>
 #include <iostream>
 
 int main(int argc, char* argv[])
 {
-	(void) argc;
-	(void) argv;
+	const Options options = ParseOptions(argc, argv);
 
-	const std::unique_ptr<Game> game = std::make_unique<Game>();
-	game->Run();
-
-	return 0;
+	const std::unique_ptr<Game> game = std::make_unique<Game>(options);
+	return game->Run();
 }